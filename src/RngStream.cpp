@@ -430,6 +430,31 @@ void RngStream::GetState (double seed[6]) const
 }
 
 
+//-------------------------------------------------------------------------
+// Get and set the current state, the start of the current substream
+// and the start of the stream, e.g. to checkpoint a simulation.
+//
+void RngStream::GetFullState (double cg[6], double bg[6], double ig[6]) const
+{
+   for (int i = 0; i < 6; ++i) {
+      cg[i] = Cg[i];
+      bg[i] = Bg[i];
+      ig[i] = Ig[i];
+   }
+}
+
+
+void RngStream::SetFullState (const double cg[6], const double bg[6],
+                              const double ig[6])
+{
+   for (int i = 0; i < 6; ++i) {
+      Cg[i] = cg[i];
+      Bg[i] = bg[i];
+      Ig[i] = ig[i];
+   }
+}
+
+
 //-------------------------------------------------------------------------
 // void RngStream::WriteState () const
 // {
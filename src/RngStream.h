@@ -61,6 +61,12 @@ void AdvanceState (int32_t e, int32_t c);
 void GetState (double seed[6]) const;
 
 
+void GetFullState (double cg[6], double bg[6], double ig[6]) const;
+
+
+void SetFullState (const double cg[6], const double bg[6], const double ig[6]);
+
+
 /* void WriteState () const; */
 
 
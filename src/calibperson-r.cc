@@ -64,9 +64,12 @@ public:
   
   static void resetPopulation ();
 
-  CalibPerson() {} // default constructor
+  CalibPerson() : stage(DiseaseFree), diseasepot(false),
+		  Lam1(0.0), sigm1(0.0), p2(0.0), lam2(0.0), mu3(0.0), tau3(0.0),
+		  clinTime(0.0), id(0) {} // default constructor
   
-  CalibPerson(double *par, int i=0) {
+  CalibPerson(double *par, int i=0) : stage(DiseaseFree), diseasepot(false),
+				       clinTime(0.0) {
     Lam1=par[0];
     sigm1=par[1];
     p2=par[2];
@@ -78,6 +81,7 @@ public:
 	
   void init();
   virtual void handleMessage(const cMessage* msg);
+  void count(Time age);
   virtual Time age() { return now(); }
 };
 
@@ -103,9 +107,12 @@ void CalibPerson::init() {
   scheduleAt(R::rexp(lam1), toPrecursor);
   double x = R::runif(0,1);
   scheduleAt((65 - 15*log(-log(x))), toDeath); //Gumbel
-  for(int i=10;i<110;i=i+10){
-    scheduleAt(i,Count);
-  }
+  // record the stage at ages 10, 20, ..., 100
+  static std::vector<Time> countAges;
+  if (countAges.empty())
+    for(int i=10;i<=100;i=i+10)
+      countAges.push_back(i);
+  Sim::observe(countAges, boost::bind(&CalibPerson::count, this, _1));
 }	
 
 /** 
@@ -114,7 +121,6 @@ void CalibPerson::init() {
 void CalibPerson::handleMessage(const cMessage* msg) {
 
   double ctime[] = {20,40,60,80};
-  int cind;
 	
 	
   if (msg->kind == toDeath) {
@@ -158,17 +164,30 @@ void CalibPerson::handleMessage(const cMessage* msg) {
     string stagestr = stage_names[stage];
   }
 	   
-  else if (msg->kind == Count){
-    cind = min(9,int(now()/10 - 1));
-    string stagestr = stage_names[stage];
-    
-    if(report.find(stagestr) == report.end()){ //key not found
-      report[stagestr].assign(10,0);
-     }
-    report[stagestr][cind]+=1;
-  }		   
 }
 
+/**
+    Record the stage at an observation age
+ */
+void CalibPerson::count(Time age) {
+  int cind = min(9,int(age/10 - 1));
+  string stagestr = stage_names[stage];
+
+  if(report.find(stagestr) == report.end()){ //key not found
+    report[stagestr].assign(10,0);
+  }
+  report[stagestr][cind]+=1;
+}
+
+
+  Process * calibPerson(CalibPerson * person, double * par, int) {
+    *person = CalibPerson(par,0);
+    return person;
+  }
+
+  void nextCalibPerson(int) {
+    rng->nextSubstream();
+  }
 
 extern "C" {
 
@@ -184,13 +203,8 @@ extern "C" {
     CalibPerson::report.insert(make_pair("TimeAtRisk", std::vector<double>()));
     
     CalibPerson person;
-    for (int i = 0; i < nin; i++) {
-      person = CalibPerson(&par[0],0);
-      rng->nextSubstream();
-      Sim::create_process(&person);
-      Sim::run_simulation();
-      Sim::clear();
-    }
+    rng->nextSubstream(); // each person starts on a new substream
+    Sim::run_population(boost::bind(calibPerson, &person, &par[0], _1), nin, nextCalibPerson);
 
     delete rng;
     
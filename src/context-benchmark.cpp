@@ -0,0 +1,214 @@
+/**
+ * @file
+ * @author  Mark Clements <mark.clements@ki.se>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Benchmark for TProcess and for the context switches behind its
+ * implementations (TPROCESS_IMPL). The "TProcess" row times a TProcess
+ * that waits for n timeouts under Sim, with the implementation that
+ * configure selected: each timeout is a pass through the schedule plus
+ * the pair of switches into and out of the process. The other rows
+ * are raw ping-pongs between the caller and a second context, n round
+ * trips each, with swapcontext() (1), setjmp/longjmp on a stack set up
+ * with sigaltstack (2) and the native switch in tcontext.h (3), as a
+ * lower bound for the same pair of switches with each implementation.
+ */
+
+// the fortified longjmp() rejects jumps between the stacks of
+// different contexts, which is what the setjmp ping-pong does (as
+// TPROCESS_IMPL 2 in tprocess.cc)
+#if !defined(_WIN32)
+#undef _FORTIFY_SOURCE
+#endif
+
+// builds without TProcess (TPROCESS_IMPL 0, on Windows)
+#define TPROCESS_OPTIONAL
+#include "tprocessconf.h"
+
+#if TPROCESS_IMPL != 0
+#include <siena/ssim.h>
+#include <siena/tprocess.h>
+#endif
+#include <siena/tcontext.h>
+#include <Rcpp.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#define CONTEXT_BENCHMARK_UCONTEXT 1
+#include <ucontext.h>
+#endif
+
+#if !defined(_WIN32)
+#define CONTEXT_BENCHMARK_SETJMP 1
+#include <setjmp.h>
+#include <signal.h>
+#endif
+
+namespace contextBenchmark {
+
+  using namespace std;
+
+  static const unsigned long StackSize = 64 * 1024;
+
+  typedef chrono::steady_clock Clock;
+
+#ifdef CONTEXT_BENCHMARK_UCONTEXT
+  static ucontext_t uc_main, uc_other;
+
+  static void ucontextBody() {
+    for (;;)
+      swapcontext(&uc_other, &uc_main);
+  }
+
+  double runUcontext(long n) {
+    vector<char> stack(StackSize);
+    getcontext(&uc_other);
+    uc_other.uc_link = NULL;
+    uc_other.uc_stack.ss_sp = &stack[0];
+    uc_other.uc_stack.ss_size = stack.size();
+    uc_other.uc_stack.ss_flags = 0;
+    makecontext(&uc_other, ucontextBody, 0);
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < n; ++i)
+      swapcontext(&uc_main, &uc_other);
+    chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+  }
+#endif
+
+#ifdef CONTEXT_BENCHMARK_SETJMP
+  static jmp_buf jb_main, jb_other;
+
+  static void setjmpStarter(int) {
+    if (setjmp(jb_other)) {
+      for (;;)
+	if (!setjmp(jb_other))
+	  longjmp(jb_main, 1);
+    }
+  }
+
+  double runSetjmp(long n) {
+    // as in TProcess::init(): start the second context in a signal
+    // handler running on its own stack
+    vector<char> stack(StackSize);
+    stack_t stack_descr, old_stack;
+    struct sigaction sa, old_sa;
+    stack_descr.ss_flags = 0;
+    stack_descr.ss_size = stack.size();
+    stack_descr.ss_sp = &stack[0];
+    sigaltstack(&stack_descr, &old_stack);
+    sa.sa_handler = setjmpStarter;
+    sa.sa_flags = SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, &old_sa);
+    raise(SIGUSR1);
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < n; ++i)
+      if (!setjmp(jb_main))
+	longjmp(jb_other, 1);
+    chrono::duration<double> elapsed = Clock::now() - start;
+    sigaction(SIGUSR1, &old_sa, 0);
+    sigaltstack(&old_stack, 0);
+    return elapsed.count();
+  }
+#endif
+
+#if SSIM_NATIVE_TCONTEXT
+  static ssim::tcontext_t tc_main, tc_other;
+
+  static void nativeBody(void *) {
+    for (;;)
+      ssim::tcontext_switch(&tc_other, tc_main);
+  }
+
+  double runNative(long n) {
+    vector<char> stack(StackSize);
+    tc_other = ssim::tcontext_make(&stack[0], stack.size(), nativeBody, 0);
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < n; ++i)
+      ssim::tcontext_switch(&tc_main, tc_other);
+    chrono::duration<double> elapsed = Clock::now() - start;
+    return elapsed.count();
+  }
+#endif
+
+#if TPROCESS_IMPL != 0
+  class Sleeper : public ssim::TProcess {
+  public:
+    Sleeper(long n) : ssim::TProcess(StackSize), n(n) {}
+    virtual void main() {
+      for (long i = 0; i < n; ++i)
+	wait_for_event(1.0);
+    }
+  private:
+    long n;
+  };
+
+  double runTProcess(long n) {
+    // a context of its own, so that the benchmark leaves the
+    // simulation of the caller alone
+    ssim::SimContext context;
+    ssim::SimContext::Scope scope(&context);
+    Sleeper sleeper(n);
+    ssim::Sim::create_process(&sleeper);
+    Clock::time_point start = Clock::now();
+    ssim::Sim::run_simulation();
+    chrono::duration<double> elapsed = Clock::now() - start;
+    ssim::Sim::clear();
+    return elapsed.count();
+  }
+#endif
+
+  RcppExport SEXP callContextSwitchBenchmark(SEXP parms) {
+    Rcpp::List parmsl(parms);
+    long n = Rcpp::as<long>(parmsl["n"]);
+    vector<string> backend;
+    vector<int> impl;
+    vector<double> switches, seconds;
+#ifdef CONTEXT_BENCHMARK_UCONTEXT
+    backend.push_back("ucontext");
+    impl.push_back(1);
+    seconds.push_back(runUcontext(n));
+#endif
+#ifdef CONTEXT_BENCHMARK_SETJMP
+    backend.push_back("setjmp");
+    impl.push_back(2);
+    seconds.push_back(runSetjmp(n));
+#endif
+#if SSIM_NATIVE_TCONTEXT
+    backend.push_back("native");
+    impl.push_back(3);
+    seconds.push_back(runNative(n));
+#endif
+    switches.assign(backend.size(), 2.0 * n);
+#if TPROCESS_IMPL != 0
+    backend.push_back("TProcess");
+    impl.push_back(TPROCESS_IMPL);
+    seconds.push_back(runTProcess(n));
+    switches.push_back(2.0 * n);
+#endif
+    return Rcpp::DataFrame::create(Rcpp::_("backend") = backend,
+				   Rcpp::_("TPROCESS_IMPL") = impl,
+				   Rcpp::_("switches") = switches,
+				   Rcpp::_("seconds") = seconds);
+  }
+
+} // namespace contextBenchmark
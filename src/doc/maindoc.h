@@ -48,7 +48,10 @@ ssim::Process Process\endlink, which defines the interface and base
 class for a reactive process, and \link ssim::TProcess
 TProcess\endlink, which defines and implements a sequential process.
 User processes can be programmed by extending either Process or
-TProcess.
+TProcess.  With a C++20 compiler, \link ssim::CoProcess
+CoProcess\endlink (in siena/coprocess.h) defines a sequential process
+whose main body is a coroutine, and that therefore needs no stack of
+its own.
 
 <p>\link ssim::Sim Sim\endlink offers the basic primitives for
 signaling \link ssim::Event events\endlink, and for creating,
@@ -25,6 +25,9 @@
 #include "microsimulation.h"
 
 #include <boost/algorithm/cxx11/iota.hpp>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
 
 namespace fhcrc_example {
 
@@ -124,18 +127,6 @@ namespace fhcrc_example {
   bool includePSArecords, panel, includeDiagnoses;
   Table<double,double> production;
 
-  class cMessageUtilityChange : public cMessage {
-  public:
-    cMessageUtilityChange(double change) : cMessage(toUtilityChange), change(change) { }
-    double change;
-  };
-
-  class cMessageBaselineUtility : public cMessage {
-  public:
-    cMessageBaselineUtility(double utility) : cMessage(toBaselineUtility), utility(utility) { }
-    double utility;
-  };
-
   template<class T>
   T bounds(T x, T a, T b) {
     return (x<a)?a:((x>b)?b:x);
@@ -156,6 +147,7 @@ namespace fhcrc_example {
     int id;
     double cohort, baseline_utility, delta_utility;
     bool everPSA, previousNegativeBiopsy, organised;
+    EventHandle metastatic, clinicalDiagnosis; // competing events
     FhcrcPerson(const int id = 0, const double cohort = 1950) :
       id(id), cohort(cohort), baseline_utility(1.0), delta_utility(0.0) { };
     double utility() { return baseline_utility + delta_utility; }
@@ -211,10 +203,10 @@ namespace fhcrc_example {
      Default: sign = -1
    **/
   void FhcrcPerson::scheduleUtilityChange(double at, std::string category, bool transient, double sign) {
-    scheduleAt(at, new cMessageUtilityChange(sign*utility_estimates[category]));
+    scheduleAt(at, toUtilityChange, sign*utility_estimates[category]);
     if (transient) {
       scheduleAt(at + utility_duration[category],
-		 new cMessageUtilityChange(-sign*utility_estimates[category]));
+		 toUtilityChange, -sign*utility_estimates[category]);
     }
   }
 
@@ -489,29 +481,15 @@ void FhcrcPerson::init() {
   // |       80 |       84 |  0.74 |    0.69 |
   // (i) set initial baseline utility
   baseline_utility = 1.00;
-  // (ii) schedule changes in the baseline utility by age
+  // (ii) schedule changes in the baseline utility by age, in one batch
   // Burström and Rehnberg (2006)
-  // (require 'cl)
-  // (let ((utilities
-  // 	 (list 1 0.89 0.89 0.88 0.87 0.84 0.84 0.83 0.83 0.82 0.83 0.81 0.79 0.74))
-  // 	(ages
-  // 	 (append (list 0 18) (loop for i from 25 to 80 by 5 collect i))))
-  //  (loop for utility in utilities for age in ages
-  //   do (message (format "scheduleAt(%g, new cMessageBaselineUtility(%g));" age utility))))
-  scheduleAt(0, new cMessageBaselineUtility(1));
-  scheduleAt(18, new cMessageBaselineUtility(0.89));
-  scheduleAt(25, new cMessageBaselineUtility(0.89));
-  scheduleAt(30, new cMessageBaselineUtility(0.88));
-  scheduleAt(35, new cMessageBaselineUtility(0.87));
-  scheduleAt(40, new cMessageBaselineUtility(0.84));
-  scheduleAt(45, new cMessageBaselineUtility(0.84));
-  scheduleAt(50, new cMessageBaselineUtility(0.83));
-  scheduleAt(55, new cMessageBaselineUtility(0.83));
-  scheduleAt(60, new cMessageBaselineUtility(0.82));
-  scheduleAt(65, new cMessageBaselineUtility(0.83));
-  scheduleAt(70, new cMessageBaselineUtility(0.81));
-  scheduleAt(75, new cMessageBaselineUtility(0.79));
-  scheduleAt(80, new cMessageBaselineUtility(0.74));
+  const int nUtilities = 14;
+  const double utilityAges[nUtilities] = {0, 18, 25, 30, 35, 40, 45, 50, 55, 60, 65, 70, 75, 80};
+  const double utilities[nUtilities] = {1, 0.89, 0.89, 0.88, 0.87, 0.84, 0.84, 0.83, 0.83, 0.82, 0.83, 0.81, 0.79, 0.74};
+  pair<Time,cMessage *> baselineUtilities[nUtilities];
+  for (int i = 0; i < nUtilities; ++i)
+    baselineUtilities[i] = std::make_pair(utilityAges[i], new cPayloadMessage<double>(toBaselineUtility, utilities[i]));
+  scheduleAll(baselineUtilities, baselineUtilities + nUtilities);
 
   // record some parameters using SimpleReport - too many for a tuple
   if (id<nLifeHistories) {
@@ -594,14 +572,14 @@ void FhcrcPerson::handleMessage(const cMessage* msg) {
     state = Localised;
     ext_grade = future_ext_grade;
     grade = future_grade;
-    scheduleAt(tc+35.0,toClinicalDiagnosis);
-    scheduleAt(tm+35.0,toMetastatic);
+    clinicalDiagnosis = scheduleAt(tc+35.0,toClinicalDiagnosis);
+    metastatic = scheduleAt(tm+35.0,toMetastatic);
     break;
 
   case toMetastatic:
     state = Metastatic;
-    RemoveKind(toClinicalDiagnosis);
-    scheduleAt(tmc+35.0,toClinicalDiagnosis);
+    cancelEvent(clinicalDiagnosis);
+    clinicalDiagnosis = scheduleAt(tmc+35.0,toClinicalDiagnosis);
     break;
 
   case toOrganised:
@@ -752,7 +730,7 @@ void FhcrcPerson::handleMessage(const cMessage* msg) {
 
   case toClinicalDiagnosis:
     dx = ClinicalDiagnosis;
-    RemoveKind(toMetastatic); // competing events
+    cancelEvent(metastatic); // competing events
     RemoveKind(toScreen);
     scheduleAt(now(), toClinicalDiagnosticBiopsy); // assumes only one biopsy per clinical diagnosis
     scheduleAt(now(), toTreatment);
@@ -760,8 +738,8 @@ void FhcrcPerson::handleMessage(const cMessage* msg) {
 
   case toScreenDiagnosis:
     dx = ScreenDiagnosis;
-    RemoveKind(toMetastatic); // competing events
-    RemoveKind(toClinicalDiagnosis);
+    cancelEvent(metastatic); // competing events
+    cancelEvent(clinicalDiagnosis);
     RemoveKind(toScreen);
     scheduleAt(now(), toTreatment);
     break;
@@ -800,7 +778,7 @@ void FhcrcPerson::handleMessage(const cMessage* msg) {
     double u_adt = R::runif(0.0,1.0);
     if (state == Metastatic) {
       lost_productivity("Metastatic cancer");
-      scheduleAt(now(), new cMessageUtilityChange(-utility_estimates["Metastatic cancer"]));
+      scheduleAt(now(), toUtilityChange, -utility_estimates["Metastatic cancer"]);
     }
     else { // Loco-regional
       tx = calculate_treatment(u_tx,now(),year);
@@ -832,7 +810,7 @@ void FhcrcPerson::handleMessage(const cMessage* msg) {
       			 calculate_mortality_hr(age_c));
       if (debug) Rprintf("hr for lead time=%f\n", calculate_mortality_hr(age_c));
       cured = (R::runif(0.0,1.0) < pcure);
-      if (cured) RemoveKind(toMetastatic);
+      if (cured) cancelEvent(metastatic);
       else {
       double u_surv = R::runif(0.0,1.0);
       age_cancer_death = calculate_survival(u_surv,age_c,age_c,calculate_treatment(u_tx,age_c,year+lead_time));
@@ -917,24 +895,13 @@ void FhcrcPerson::handleMessage(const cMessage* msg) {
     break;
 
   case toBaselineUtility:
-    {
-      const cMessageBaselineUtility * msgUtility;
-      if ((msgUtility = dynamic_cast<const cMessageBaselineUtility *>(msg)) != 0) {
-	baseline_utility = msgUtility->utility;
-      } else {
-	REprintf("Could not cast to cMessageBaselineUtility.");
-      }
-    } break;
+    // the kind identifies a cPayloadMessage<double>
+    baseline_utility = payload<double>(msg);
+    break;
 
   case toUtilityChange:
-    {
-      const cMessageUtilityChange * msgUtilityChange;
-      if ((msgUtilityChange = dynamic_cast<const cMessageUtilityChange *>(msg)) != 0) {
-	delta_utility += msgUtilityChange->change;
-      } else {
-	REprintf("Could not cast to cMessageUtilityChange.");
-      }
-    } break;
+    delta_utility += payload<double>(msg);
+    break;
 
   default:
     REprintf("No valid kind of event: %i\n",msg->kind);
@@ -945,6 +912,125 @@ void FhcrcPerson::handleMessage(const cMessage* msg) {
 } // handleMessage()
 
 
+/**
+   Checkpoints for callFhcrc(): after every checkpointInterval men, the number of men completed,
+   the random number streams and the output objects are written to checkpointFile.
+   A run that is resumed from a checkpoint gives the same output as an uninterrupted run.
+*/
+string checkpointFile;
+int checkpointInterval = 0, checkpointFirstId = 0, checkpointN = 0, checkpointStart = 0;
+const char checkpointTag[8] = {'F','H','C','R','C','K','P','1'};
+
+void saveRngs(ostream & out) {
+  rngNh->save(out);
+  rngOther->save(out);
+  rngScreen->save(out);
+  rngTreatment->save(out);
+}
+
+void loadRngs(istream & in) {
+  rngNh->load(in);
+  rngOther->load(in);
+  rngScreen->load(in);
+  rngTreatment->load(in);
+}
+
+void saveCheckpoint(int completed) {
+  // write to a temporary file and then replace the checkpoint, so that an interrupted
+  // write leaves the previous checkpoint intact
+  string tmp = checkpointFile + ".tmp";
+  try {
+    ofstream out(tmp.c_str(), ios::binary | ios::trunc);
+    serialize::write_tag(out, checkpointTag);
+    serialize::write(out, checkpointFirstId);
+    serialize::write(out, checkpointN);
+    serialize::write(out, completed);
+    saveRngs(out);
+    report.save(out);
+    shortReport.save(out);
+    costs.save(out);
+    serialize::write(out, lifeHistories);
+    outParameters.save(out);
+    psarecord.save(out);
+    falsePositives.save(out);
+    diagnoses.save(out);
+    out.close();
+    serialize::check(out);
+  }
+  catch (serialize::error & e) {
+    REprintf("Could not write checkpoint %s: %s\n", tmp.c_str(), e.what());
+    return;
+  }
+  // rename() replaces the previous checkpoint atomically, except on
+  // Windows, where the target must not exist
+#ifdef _WIN32
+  std::remove(checkpointFile.c_str());
+#endif
+  if (std::rename(tmp.c_str(), checkpointFile.c_str()) != 0)
+    REprintf("Could not rename checkpoint %s\n", tmp.c_str());
+}
+
+/**
+   Restore the state from checkpointFile, returning the number of men completed.
+   Returns zero (with the random number streams unchanged) if there is no usable
+   checkpoint for this chunk of men.
+*/
+int loadCheckpoint() {
+  ifstream in(checkpointFile.c_str(), ios::binary);
+  if (!in) return 0;
+  stringstream rngs(ios::in | ios::out | ios::binary);
+  saveRngs(rngs);
+  try {
+    int firstId, n, completed;
+    serialize::read_tag(in, checkpointTag);
+    serialize::read(in, firstId);
+    serialize::read(in, n);
+    serialize::read(in, completed);
+    if (firstId != checkpointFirstId || n != checkpointN || completed < 0 || completed > n) {
+      REprintf("Checkpoint %s is for a different run: starting from the beginning\n", checkpointFile.c_str());
+      return 0;
+    }
+    loadRngs(in);
+    report.load(in);
+    shortReport.load(in);
+    costs.load(in);
+    serialize::read(in, lifeHistories);
+    outParameters.load(in);
+    psarecord.load(in);
+    falsePositives.load(in);
+    diagnoses.load(in);
+    return completed;
+  }
+  catch (serialize::error & e) {
+    REprintf("Could not read checkpoint %s (%s): starting from the beginning\n", checkpointFile.c_str(), e.what());
+    loadRngs(rngs);
+    return 0;
+  }
+}
+
+/**
+   Population runner callbacks for callFhcrc(): re-initialise the person for the i-th man
+   (counting from the start of this run), and move the random number streams to their next
+   substreams after each man.
+*/
+Process * fhcrcPerson(FhcrcPerson * person, int firstId, NumericVector * cohort, int i) {
+  i += checkpointStart;
+  *person = FhcrcPerson(i+firstId,(*cohort)[i]);
+  Sim::set_trace_person(i+firstId);
+  return person;
+}
+
+void nextFhcrcPerson(int i) {
+  rngNh->nextSubstream();
+  rngOther->nextSubstream();
+  rngScreen->nextSubstream();
+  rngTreatment->nextSubstream();
+  int completed = checkpointStart + i + 1;
+  if (checkpointInterval > 0 && completed % checkpointInterval == 0)
+    saveCheckpoint(completed);
+  R_CheckUserInterrupt();  /* be polite -- did the user hit ctrl-C? */
+}
+
 RcppExport SEXP callFhcrc(SEXP parmsIn) {
 
   // declarations
@@ -1071,6 +1157,13 @@ RcppExport SEXP callFhcrc(SEXP parmsIn) {
   boost::algorithm::iota(ages.begin(), ages.end(), 0.0);
   ages.push_back(1.0e+6);
 
+  // checkpoints
+  checkpointFile = as<string>(parms["checkpointFile"]);
+  checkpointInterval = as<int>(parms["checkpointInterval"]);
+  checkpointFirstId = firstId;
+  checkpointN = n;
+  checkpointStart = 0;
+
   // re-set the output objects
   report.clear();
   shortReport.clear();
@@ -1088,17 +1181,24 @@ RcppExport SEXP callFhcrc(SEXP parmsIn) {
   costs.discountRate = parameter["discountRate.costs"];
   costs.setPartition(ages);
 
+  // resume from a checkpoint (the partitions are restored with the reports)
+  if (as<bool>(parms["resume"]))
+    checkpointStart = loadCheckpoint();
+
+  Sim::reset_arena_stats();
+  Sim::reset_stats();
+
+  // kernel event trace: the last `trace` events, dumped on errors (optionally at each stop) and at the end
+  int trace = as<int>(parms["trace"]);
+  Sim::set_trace(trace, as<string>(parms["traceFile"]),
+		 TRACE_DUMP_ON_ERROR | (as<bool>(parms["traceOnStop"]) ? TRACE_DUMP_ON_STOP : 0));
+
   // main loop
-  for (int i = 0; i < n; ++i) {
-    person = FhcrcPerson(i+firstId,cohort[i]);
-    Sim::create_process(&person);
-    Sim::run_simulation();
-    Sim::clear();
-    rngNh->nextSubstream();
-    rngOther->nextSubstream();
-    rngScreen->nextSubstream();
-    rngTreatment->nextSubstream();
-    R_CheckUserInterrupt();  /* be polite -- did the user hit ctrl-C? */
+  Sim::run_population(boost::bind(fhcrcPerson, &person, firstId, &cohort, _1), n - checkpointStart, nextFhcrcPerson);
+
+  if (trace > 0) {
+    Sim::dump_trace();
+    Sim::set_trace(0);
   }
 
   // tidy up
@@ -1107,6 +1207,26 @@ RcppExport SEXP callFhcrc(SEXP parmsIn) {
   delete rngScreen;
   delete rngTreatment;
 
+  // event allocation counters (malloc calls should stay near zero in steady state)
+  const ArenaStats & arenaStats = Sim::arena_stats();
+  List arena = List::create(_("allocations") = double(arenaStats.allocations),
+			    _("system_allocations") = double(arenaStats.system_allocations),
+			    _("resets") = double(arenaStats.resets),
+			    _("reserved") = double(arenaStats.reserved));
+
+  // kernel counters, and the number of events executed by kind
+  const KernelStats & kernelStats = Sim::stats();
+  List kernel = List::create(_("popped") = double(kernelStats.popped),
+			     _("executed") = double(kernelStats.executed),
+			     _("inserts") = double(kernelStats.inserts),
+			     _("cancelled") = double(kernelStats.cancelled),
+			     _("removed") = double(kernelStats.removed),
+			     _("busy") = double(kernelStats.busy),
+			     _("terminated") = double(kernelStats.terminated),
+			     _("out_of_order") = double(kernelStats.out_of_order),
+			     _("max_queue") = double(kernelStats.max_queue));
+  vector<double> kernelKinds(kernelStats.kinds.begin(), kernelStats.kinds.end());
+
   // output
   // TODO: clean up these objects in C++ (cf. R)
   return List::create(_("costs") = costs.wrap(),                // CostReport
@@ -1116,7 +1236,10 @@ RcppExport SEXP callFhcrc(SEXP parmsIn) {
 		      _("parameters") = outParameters.wrap(),   // SimpleReport<double>
 		      _("psarecord")=psarecord.wrap(),          // SimpleReport<double>
 		      _("falsePositives")=falsePositives.wrap(),// SimpleReport<double>
-		      _("diagnoses")=diagnoses.wrap()           // SimpleReport<double>
+		      _("diagnoses")=diagnoses.wrap(),          // SimpleReport<double>
+		      _("arena")=arena,                         // ArenaStats
+		      _("kernel")=kernel,                       // KernelStats
+		      _("kernelKinds")=wrap(kernelKinds)        // KernelStats::kinds
 		      );
 }
 
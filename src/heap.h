@@ -26,6 +26,8 @@
 #define _heap_h
 
 #include <vector>
+#include <algorithm>
+#include <iterator>
 
 namespace ssim {
 
@@ -62,15 +64,73 @@ private:
     static size_type right(size_type pos) throw() { return (pos + 1)*2; }
     static size_type parent(size_type pos) throw() { return (pos - 1)/2; }
 
+    void sift_down(size_type k) throw() {
+	size_type k_next;
+	for(;;) {
+	    k_next = left(k);
+	    if (k_next > last()) {
+		break;
+	    }
+	    if (right(k) <= last() && a[right(k)] < a[k_next]) {
+		k_next = right(k);
+	    }
+	    if (a[k_next] < a[k]) {
+		swap(a[k], a[k_next]);
+		k = k_next;
+	    } else {
+		break;
+	    }
+	}
+    }
+
+    // restores the heap order bottom-up (Floyd), in O(n)
+    void heapify() throw() {
+	if (a.size() > 1)
+	    for(size_type k = parent(last()) + 1; k-- > FIRST; )
+		sift_down(k);
+    }
+
 public:
+    static const char * name() throw() { return "binary"; }
+
     bool empty() throw() { return a.empty(); }
+    size_type size() const throw() { return a.size(); }
     iterator begin() throw() { return a.begin(); }
     iterator end() throw() { return a.end(); }
     const_iterator begin() const  throw() { return a.begin(); }
     const_iterator end() const throw() { return a.end(); }
+    const T & operator[](size_type i) const throw() { return a[i]; }
+    const T & first() const throw() { return a[0]; }
     void clear() throw() { a.clear(); }
     iterator erase(iterator first, iterator last) throw() {return a.erase(first, last); }
 
+    // removes all the elements that satisfy the given predicate, and
+    // then restores the heap order bottom-up (Floyd)
+    //
+    template <typename Predicate>
+    size_type remove_if(Predicate pred) {
+	size_type n = a.size();
+	a.erase(std::remove_if(a.begin(), a.end(), pred), a.end());
+	heapify();
+	return n - a.size();
+    }
+
+    // inserts the elements in [i, end).  When they are at least as
+    // many as the elements already in the heap, they are appended and
+    // the heap order is restored with one heapify(), otherwise they
+    // are inserted one by one
+    //
+    template <typename Iterator>
+    void insert_bulk(Iterator i, Iterator end) {
+	if (size_type(std::distance(i, end)) < a.size()) {
+	    for(; i != end; ++i)
+		insert(*i);
+	} else {
+	    a.insert(a.end(), i, end);
+	    heapify();
+	}
+    }
+
     void insert(const T & x) throw() {
 	a.push_back(x);
 	size_type k = last();
@@ -95,25 +155,502 @@ public:
 	}
 	a[FIRST] = a[last()];
 	a.pop_back();
-	size_type k = FIRST;
-	size_type k_next;
+	sift_down(FIRST);
+	return res;
+    }
+};
+
+//
+// This is an implicit d-ary heap (D = 4 by default).  Contrary to
+// the binary heap above, insert and pop_first move a "hole" along
+// the path and assign each element once, instead of swapping.  With
+// D = 4 the children of a node are adjacent, so a sift-down step
+// compares elements that typically share a cache line, and the heap
+// is half as deep as the binary heap.
+//
+template <typename T, unsigned D = 4>
+class dary_heap {
+public:
+    typedef typename std::vector<T>::size_type		size_type;
+    typedef typename std::vector<T>::iterator		iterator;
+    typedef typename std::vector<T>::const_iterator	const_iterator;
+
+private:
+    std::vector<T> a;
+
+    static size_type first_child(size_type pos) throw() { return pos*D + 1; }
+    static size_type parent(size_type pos) throw() { return (pos - 1)/D; }
+
+    // moves the hole at position k down to where x belongs, then
+    // fills it with x
+    //
+    void sift_down(size_type k, const T & x) throw() {
+	size_type n = a.size();
 	for(;;) {
-	    k_next = left(k);
-	    if (k_next > last()) {
+	    size_type c = first_child(k);
+	    if (c >= n) 
+		break;
+	    size_type c_end = (c + D < n) ? c + D : n;
+	    size_type c_min = c;
+	    for(++c; c < c_end; ++c)
+		if (a[c] < a[c_min])
+		    c_min = c;
+	    if (a[c_min] < x) {
+		a[k] = a[c_min];
+		k = c_min;
+	    } else {
 		break;
 	    }
-	    if (right(k) <= last() && a[right(k)] < a[k_next]) {
-		k_next = right(k);
+	}
+	a[k] = x;
+    }
+
+    // restores the heap order bottom-up (Floyd), in O(n)
+    void heapify() throw() {
+	if (a.size() > 1)
+	    for(size_type k = parent(a.size() - 1) + 1; k-- > 0; ) {
+		T x = a[k];
+		sift_down(k, x);
 	    }
-	    if (a[k_next] < a[k]) {
-		swap(a[k], a[k_next]);
-		k = k_next;
+    }
+
+public:
+    static const char * name() throw() { return "dary"; }
+
+    bool empty() throw() { return a.empty(); }
+    size_type size() const throw() { return a.size(); }
+    iterator begin() throw() { return a.begin(); }
+    iterator end() throw() { return a.end(); }
+    const_iterator begin() const  throw() { return a.begin(); }
+    const_iterator end() const throw() { return a.end(); }
+    const T & operator[](size_type i) const throw() { return a[i]; }
+    const T & first() const throw() { return a[0]; }
+    void clear() throw() { a.clear(); }
+
+    void insert(const T & x) throw() {
+	a.push_back(x);
+	size_type k = a.size() - 1;
+	while(k > 0) {
+	    size_type k_parent = parent(k);
+	    if (x < a[k_parent]) {
+		a[k] = a[k_parent];
+		k = k_parent;
 	    } else {
 		break;
 	    }
 	}
+	a[k] = x;
+    }
+
+    T pop_first() throw() {
+	// ASSERT( !empty() )
+	T res = a[0];
+	T x = a.back();
+	a.pop_back();
+	if (!a.empty())
+	    sift_down(0, x);
 	return res;
     }
+
+    template <typename Predicate>
+    size_type remove_if(Predicate pred) {
+	size_type n = a.size();
+	a.erase(std::remove_if(a.begin(), a.end(), pred), a.end());
+	heapify();
+	return n - a.size();
+    }
+
+    // inserts the elements in [i, end), as heap::insert_bulk()
+    template <typename Iterator>
+    void insert_bulk(Iterator i, Iterator end) {
+	if (size_type(std::distance(i, end)) < a.size()) {
+	    for(; i != end; ++i)
+		insert(*i);
+	} else {
+	    a.insert(a.end(), i, end);
+	    heapify();
+	}
+    }
+};
+
+//
+// This is a pairing heap (Fredman, Sedgewick, Sleator, and Tarjan,
+// "The pairing heap: a new form of self-adjusting heap",
+// Algorithmica 1:111--129, 1986) with the standard two-pass
+// pop_first.  Insert is O(1), and pop_first is O(log n) amortized.
+//
+// The nodes are kept densely in a vector and linked by index, so
+// that there is no allocation per insert once the vector has grown,
+// and so that the elements can be visited in storage order like the
+// array-based heaps above.  Every node links to its leftmost child,
+// to its right sibling, and back to its left sibling or, for a
+// leftmost child, to its parent.
+//
+template <typename T>
+class pairing_heap {
+public:
+    typedef unsigned				index_type;
+    typedef typename std::vector<T>::size_type	size_type;
+
+private:
+    static const index_type NIL = ~index_type(0);
+
+    struct node {
+	T value;
+	index_type child, next, prev;
+	node(const T & x) : value(x), child(NIL), next(NIL), prev(NIL) {}
+    };
+    std::vector<node> nodes;
+    index_type root;
+    std::vector<index_type> pairs;	// scratch space for pop_first
+
+    // links two roots, returns the new root
+    index_type meld(index_type x, index_type y) throw() {
+	if (nodes[y].value < nodes[x].value) {
+	    index_type t = x; x = y; y = t;
+	}
+	// y becomes the leftmost child of x
+	node & nx = nodes[x];
+	node & ny = nodes[y];
+	ny.prev = x;
+	ny.next = nx.child;
+	if (nx.child != NIL)
+	    nodes[nx.child].prev = y;
+	nx.child = y;
+	nx.next = NIL;
+	nx.prev = NIL;
+	return x;
+    }
+
+    // moves node "from" into the free storage position "to", fixing
+    // all the links that point to "from"
+    void relocate(index_type from, index_type to) throw() {
+	node & n = nodes[from];
+	if (n.prev != NIL) {
+	    node & p = nodes[n.prev];
+	    if (p.child == from) p.child = to; else p.next = to;
+	}
+	if (n.next != NIL) nodes[n.next].prev = to;
+	if (n.child != NIL) nodes[n.child].prev = to;
+	if (root == from) root = to;
+	nodes[to] = n;
+    }
+
+    void rebuild() {
+	root = NIL;
+	for(index_type i = 0; i < nodes.size(); ++i) {
+	    nodes[i].child = nodes[i].next = nodes[i].prev = NIL;
+	    root = (root == NIL) ? i : meld(root, i);
+	}
+    }
+
+public:
+    pairing_heap() : root(NIL) {}
+
+    static const char * name() throw() { return "pairing"; }
+
+    bool empty() throw() { return nodes.empty(); }
+    size_type size() const throw() { return nodes.size(); }
+    const T & operator[](size_type i) const throw() { return nodes[i].value; }
+    const T & first() const throw() { return nodes[root].value; }
+    void clear() throw() { nodes.clear(); root = NIL; }
+
+    void insert(const T & x) throw() {
+	index_type i = nodes.size();
+	nodes.push_back(node(x));
+	root = (root == NIL) ? i : meld(root, i);
+    }
+
+    T pop_first() throw() {
+	// ASSERT( !empty() )
+	index_type r = root;
+	T res = nodes[r].value;
+	// first pass: meld the children pairwise, left to right
+	pairs.clear();
+	index_type c = nodes[r].child;
+	while (c != NIL) {
+	    index_type d = nodes[c].next;
+	    if (d == NIL) {
+		nodes[c].prev = NIL;
+		pairs.push_back(c);
+		break;
+	    }
+	    index_type e = nodes[d].next;
+	    nodes[c].prev = nodes[c].next = NIL;
+	    nodes[d].prev = nodes[d].next = NIL;
+	    pairs.push_back(meld(c, d));
+	    c = e;
+	}
+	// second pass: meld the pairs, right to left
+	root = NIL;
+	for(size_type i = pairs.size(); i-- > 0; )
+	    root = (root == NIL) ? pairs[i] : meld(pairs[i], root);
+	// keep the storage dense
+	index_type last = nodes.size() - 1;
+	if (r != last)
+	    relocate(last, r);
+	nodes.pop_back();
+	return res;
+    }
+
+    template <typename Predicate>
+    size_type remove_if(Predicate pred) {
+	size_type n = nodes.size(), j = 0;
+	for(size_type i = 0; i < n; ++i)
+	    if (!pred(nodes[i].value))
+		nodes[j++] = nodes[i];
+	nodes.erase(nodes.begin() + j, nodes.end());
+	rebuild();
+	return n - j;
+    }
+
+    // inserts the elements in [i, end).  Insert is O(1) already, so
+    // they are simply inserted one by one
+    template <typename Iterator>
+    void insert_bulk(Iterator i, Iterator end) {
+	for(; i != end; ++i)
+	    insert(*i);
+    }
+};
+
+//
+// This is a radix heap (Ahuja, Mehlhorn, Orlin, and Tarjan, "Faster
+// algorithms for the shortest path problem", JACM 37:213--223, 1990)
+// for monotone keys: elements come out in increasing order of an
+// unsigned 64-bit key, given by KeyOf, and no key is inserted below
+// the key of the last element popped.  Bucket 0 holds the elements
+// with the last key; bucket i > 0 holds the elements whose key first
+// differs from the last key in bit i - 1.  When bucket 0 runs empty,
+// the smallest non-empty bucket is redistributed around its minimum
+// key into lower buckets, so every element moves at most 64 times and
+// insert and pop_first are O(1) amortized.
+//
+// Elements with equal keys are ordered with operator <, by keeping
+// bucket 0 as a small binary heap.  The last key only moves when an
+// element is popped: first() finds the least element of the lowest
+// bucket without splitting it (and remembers where it is), so a peek
+// does not stop keys between the last popped key and the least one
+// from being inserted.  An element with a key below the last key
+// breaks the monotone order; it goes to an overflow binary heap, which
+// is merged on pop_first, so the order is always correct (and the
+// overflow heap stays empty when keys are monotone).
+//
+template <typename T, typename KeyOf>
+class radix_heap {
+public:
+    typedef unsigned long long				key_type;
+    typedef typename std::vector<T>::size_type		size_type;
+
+private:
+    static const unsigned Buckets = 65;
+
+    std::vector<T> buckets[Buckets];
+    heap<T> overflow;			// keys below last
+    key_type last;			// key of the last element popped
+    key_type used;			// bit b - 1 is set if bucket b > 0 is non-empty
+    size_type n;			// elements in the buckets
+    KeyOf key;
+
+    // position of the least element, when bucket 0 is empty (see least())
+    bool peeked;
+    unsigned peek_bucket;
+    size_type peek_index;
+
+    // position of the last element looked up with operator[], so
+    // that a scan in index order costs O(1) per element
+    mutable size_type cache_index, cache_base;
+    mutable unsigned cache_bucket;
+
+    void uncache() const throw() {
+	cache_index = cache_base = 0;
+	cache_bucket = 0;
+    }
+
+    struct greater {
+	bool operator()(const T & a, const T & b) const { return b < a; }
+    };
+
+    // number of significant bits of x
+    static unsigned bits(key_type x) throw() {
+#if defined(__GNUC__)
+	return x == 0 ? 0 : 64 - __builtin_clzll(x);
+#else
+	unsigned b = 0;
+	for(; x != 0; x >>= 1) ++b;
+	return b;
+#endif
+    }
+
+    // index of the lowest set bit of x, which is not 0
+    static unsigned lowest(key_type x) throw() {
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	unsigned b = 0;
+	for(; (x & 1) == 0; x >>= 1) ++b;
+	return b;
+#endif
+    }
+
+    static unsigned bucket(key_type k, key_type l) throw() { return bits(k ^ l); }
+
+    void push(const T & x, unsigned b) {
+	std::vector<T> & v = buckets[b];
+	v.push_back(x);
+	if (b == 0) {
+	    if (v.size() > 1)
+		std::push_heap(v.begin(), v.end(), greater());
+	    peeked = false;
+	} else {
+	    used |= key_type(1) << (b - 1);
+	    // a lower bucket only holds lower keys
+	    if (peeked && (b < peek_bucket 
+			   || (b == peek_bucket && x < buckets[b][peek_index]))) {
+		peek_bucket = b;
+		peek_index = v.size() - 1;
+	    }
+	}
+	uncache();
+    }
+
+    // the least element of the buckets, or 0 if they are empty.  The
+    // lowest non-empty bucket holds it, and is only scanned again
+    // after a pop or a removal
+    const T * least() throw() {
+	if (!buckets[0].empty())
+	    return &buckets[0].front();
+	if (n == 0)
+	    return 0;
+	if (!peeked) {
+	    peek_bucket = lowest(used) + 1;
+	    const std::vector<T> & v = buckets[peek_bucket];
+	    peek_index = 0;
+	    for(size_type i = 1; i < v.size(); ++i)
+		if (v[i] < v[peek_index])
+		    peek_index = i;
+	    peeked = true;
+	}
+	return &buckets[peek_bucket][peek_index];
+    }
+
+    // makes bucket 0 non-empty, unless the buckets are empty.  Called
+    // only to pop, so last becomes the key that is popped next
+    void refill() {
+	if (!buckets[0].empty() || n == 0) 
+	    return;
+	least();
+	unsigned b = peek_bucket;
+	last = key(buckets[b][peek_index]);
+	peeked = false;
+	used &= used - 1;
+	std::vector<T> & v = buckets[b];
+	for(size_type i = 0; i < v.size(); ++i)
+	    push(v[i], bucket(key(v[i]), last));
+	v.clear();
+    }
+
+    bool overflow_first(const T * b) throw() {
+	return !overflow.empty() && (b == 0 || overflow.first() < *b);
+    }
+
+public:
+    radix_heap() : last(0), used(0), n(0), 
+		   peeked(false), peek_bucket(0), peek_index(0),
+		   cache_index(0), cache_base(0), cache_bucket(0) {}
+
+    static const char * name() throw() { return "radix"; }
+
+    bool empty() throw() { return n == 0 && overflow.empty(); }
+    size_type size() const throw() { return n + overflow.size(); }
+
+    // elements in no particular order
+    const T & operator[](size_type i) const throw() {
+	if (i < overflow.size())
+	    return overflow[i];
+	i -= overflow.size();
+	if (i < cache_index)
+	    uncache();
+	while (i - cache_base >= buckets[cache_bucket].size()) {
+	    cache_base += buckets[cache_bucket].size();
+	    ++cache_bucket;
+	}
+	cache_index = i;
+	return buckets[cache_bucket][i - cache_base];
+    }
+
+    const T & first() throw() {
+	// ASSERT( !empty() )
+	const T * b = least();
+	return overflow_first(b) ? overflow.first() : *b;
+    }
+
+    // elements in the overflow heap, inserted below the last key
+    size_type overflow_size() const throw() { return overflow.size(); }
+
+    void clear() throw() {
+	buckets[0].clear();
+	for(; used != 0; used &= used - 1)
+	    buckets[lowest(used) + 1].clear();
+	overflow.clear();
+	last = 0;
+	n = 0;
+	peeked = false;
+	uncache();
+    }
+
+    void insert(const T & x) throw() {
+	key_type k = key(x);
+	if (k < last) {
+	    // the keys are not monotone (the kernel counts these, see
+	    // KernelStats::out_of_order)
+	    overflow.insert(x);
+	    return;
+	}
+	push(x, bucket(k, last));
+	++n;
+    }
+
+    T pop_first() throw() {
+	// ASSERT( !empty() )
+	if (overflow_first(least()))
+	    return overflow.pop_first();
+	refill();
+	std::vector<T> & v = buckets[0];
+	if (v.size() > 1)
+	    std::pop_heap(v.begin(), v.end(), greater());
+	T res = v.back();
+	v.pop_back();
+	--n;
+	uncache();
+	return res;
+    }
+
+    // inserts the elements in [i, end).  Insert is O(1) already, so
+    // they are simply inserted one by one
+    template <typename Iterator>
+    void insert_bulk(Iterator i, Iterator end) {
+	for(; i != end; ++i)
+	    insert(*i);
+    }
+
+    template <typename Predicate>
+    size_type remove_if(Predicate pred) {
+	size_type removed = overflow.remove_if(pred);
+	used = 0;
+	for(unsigned b = 0; b < Buckets; ++b) {
+	    std::vector<T> & v = buckets[b];
+	    size_type m = v.size();
+	    v.erase(std::remove_if(v.begin(), v.end(), pred), v.end());
+	    removed += m - v.size();
+	    n -= m - v.size();
+	    if (b > 0 && !v.empty())
+		used |= key_type(1) << (b - 1);
+	}
+	std::make_heap(buckets[0].begin(), buckets[0].end(), greater());
+	peeked = false;
+	uncache();
+	return removed;
+    }
 };
 
 } // end namespace ssim
@@ -8,25 +8,34 @@ namespace illnessDeath {
 
   enum state_t {Healthy,Cancer};
   
-  enum event_t {toOtherDeath, toCancer, toCancerDeath};
+  enum event_t {toOtherDeath, toCancer, toCancerDeath, nEventKinds};
 
   EventReport<short,short,double> report;
   double cure, zsd; // parameters - could be static class variables
+  bool concurrent; // all persons on one schedule (Sim::run_concurrent)
   
 
   double b_weibull(double mean, double a, double rr = 1.0) {
     return mean/R::gammafn(1.0+1.0/a)*pow(rr,-1.0/a);
   }
 
-  class SimplePerson : public cProcess 
+  class SimplePerson : public cProcessT<SimplePerson>
   {
   public:
     state_t state;
     int id;
     double z;
-    SimplePerson(const int i = 0) : id(i) {};
+    EventHandle otherDeath;
+    SimplePerson(const int i = 0) : state(Healthy), id(i), z(1.0) {};
     void init();
-    virtual void handleMessage(const cMessage* msg);
+    void leave();
+    void death(const cMessage* msg);
+    void cancer(const cMessage* msg);
+    // handlers by event kind: toOtherDeath, toCancer, toCancerDeath
+    typedef Handlers<&SimplePerson::death, &SimplePerson::cancer, &SimplePerson::death> handlers;
+    static_assert(toOtherDeath == 0 && toCancer == 1 && toCancerDeath == 2,
+		  "handlers are listed in the order of event_t");
+    static_assert(handlers::size == nEventKinds, "one handler per event kind");
   };
   
   /** 
@@ -35,41 +44,62 @@ namespace illnessDeath {
   void SimplePerson::init() {
     state = Healthy;
     z = exp(R::rnorm(0.0,zsd));
-    scheduleAt(R::rweibull(4.0,b_weibull(80.0,4.0)), toOtherDeath);
+    otherDeath = scheduleAt(R::rweibull(4.0,b_weibull(80.0,4.0)), toOtherDeath);
     if (R::runif(0.0,1.0)>cure)
       scheduleAt(R::rweibull(3.0,b_weibull(80.0,3.0,z)), toCancer);
   }
   
+  /**
+      End the simulation for this person: with a shared schedule, only this process is stopped
+  */
+  void SimplePerson::leave() {
+    if (concurrent) {
+      RemoveKind(toCancer);
+      Sim::stop_process();
+    }
+    else
+      Sim::stop_simulation();
+  }
+
   /** 
-      Handle receiving self-messages
+      Handle death from other causes or from cancer
   */
-  void SimplePerson::handleMessage(const cMessage* msg) {
-    
+  void SimplePerson::death(const cMessage* msg) {
     report.add(state, msg->kind, previousEventTime, now());
-    
-    switch(msg->kind) {
-      
-    case toOtherDeath: 
-    case toCancerDeath: 
-      // reporting already completed: stop the simulation
-      Sim::stop_simulation();
-      break;
-      
-    case toCancer:
-      state = Cancer;
-      RemoveKind(toOtherDeath);
-      if (R::runif(0.0,1.0) < 0.5) // cure fraction
-	scheduleAt(now() + R::rweibull(1.0,10.0), toCancerDeath);
-      break;
-      
-    default:
-      REprintf("No valid kind of event\n");
-      break;
-      
-    } // switch
-    
-  } // handleMessage()
+    // reporting already completed: stop the simulation
+    leave();
+  }
+
+  /** 
+      Handle cancer onset
+  */
+  void SimplePerson::cancer(const cMessage* msg) {
+    report.add(state, msg->kind, previousEventTime, now());
+    state = Cancer;
+    cancelEvent(otherDeath);
+    if (R::runif(0.0,1.0) < 0.5) // cure fraction
+      scheduleAt(now() + R::rweibull(1.0,10.0), toCancerDeath);
+    else if (concurrent)
+      leave(); // no further events
+  }
   
+  Process * simplePerson(SimplePerson * person, int i) {
+    *person = SimplePerson(i);
+    return person;
+  }
+
+  // concurrent mode: one process per living person
+  boost::unordered_map<int,SimplePerson *> living;
+
+  Process * newSimplePerson(int i) {
+    return living[i] = new SimplePerson(i);
+  }
+
+  void deleteSimplePerson(int i) {
+    delete living[i];
+    living.erase(i);
+  }
+
   RcppExport SEXP callIllnessDeath(SEXP parms) {
     SimplePerson person;
     Rcpp::RNGScope scope;
@@ -77,6 +107,8 @@ namespace illnessDeath {
     int n = Rcpp::as<int>(parmsl["n"]);
     cure = Rcpp::as<double>(parmsl["cure"]);
     zsd = Rcpp::as<double>(parmsl["zsd"]);
+    concurrent = Rcpp::as<bool>(parmsl["concurrent"]);
+    double window = Rcpp::as<double>(parmsl["window"]); // report snapshots (concurrent only)
     
     vector<double> ages(101);
     boost::algorithm::iota(ages.begin(), ages.end(), 0.0);
@@ -84,12 +116,27 @@ namespace illnessDeath {
     report.clear();
     report.setPartition(ages);
     
-    for (int i = 0; i < n; i++) {
-      person = SimplePerson(i);
-      Sim::create_process(&person);
-      Sim::run_simulation();
+    Rcpp::List windows;
+    if (concurrent && window > 0.0) {
+      // cumulative report at the end of each window
+      Sim::create_population(newSimplePerson, n, PopulationEntry(), deleteSimplePerson);
+      for (double t = window; Sim::run_until(t); t += window)
+	windows.push_back(report.snapshot());
+      windows.push_back(report.snapshot()); // the last window
       Sim::clear();
     }
+    else if (concurrent)
+      Sim::run_concurrent(newSimplePerson, n, PopulationEntry(), deleteSimplePerson);
+    else
+      Sim::run_population(boost::bind(simplePerson, &person, _1), n);
+    for (boost::unordered_map<int,SimplePerson *>::iterator it = living.begin(); it != living.end(); ++it)
+      delete it->second;
+    living.clear();
+    if (concurrent && window > 0.0) { // only when the windows were run
+      Rcpp::List out(report.wrap());
+      out.push_back(windows, "windows");
+      return out;
+    }
     return report.wrap();
   } 
   
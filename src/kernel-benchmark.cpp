@@ -0,0 +1,208 @@
+/**
+ * @file
+ * @author  Mark Clements <mark.clements@ki.se>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Benchmark for the event list backends of the ssim kernel. Each
+ * backend is driven with the same synthetic event mix, which is
+ * modelled on a person in the FHCRC model: a batch of events at
+ * initialisation (baseline utilities, onset, other-cause death and a
+ * first screen), followed by churn from screens, pairs of utility
+ * changes (one now, one later) and immediate follow-up events, until
+ * death clears the queue.  The same mix is also run as a cProcess
+ * through Sim, with the event list the kernel was built with, since
+ * the kernel peeks at the schedule between inserts, which the
+ * containers alone are not asked to do.
+ */
+
+#include "microsimulation.h"
+#include "heap.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace kernelBenchmark {
+
+  using namespace std;
+  using namespace ssim;
+
+  enum event_t {toBaselineUtility, toLocalised, toOtherDeath, toScreen,
+		toUtilityChange, toFollowUp};
+
+  //! an action with the same layout as the kernel's actions: a packed (time, order) key and a slot
+  struct BenchAction {
+    unsigned long long key, order;
+    unsigned slot;
+    BenchAction(Time t = 0.0, int type = 0, unsigned long long seq = 0) : order(seq), slot(type) {
+      // times are non-negative here, so their bits are ordered
+      std::memcpy(&key, &t, sizeof(key));
+    }
+    Time time() const { Time t; std::memcpy(&t, &key, sizeof(t)); return t; }
+    int type() const { return slot; }
+    bool operator < (const BenchAction & a) const { return key < a.key || (key == a.key && order < a.order); }
+  };
+
+  //! the key of the radix heap: the bits of the time
+  struct BenchTimeKey {
+    unsigned long long operator()(const BenchAction & a) const { return a.key; }
+  };
+
+  //! small LCG, so that the random numbers do not dominate the timing
+  class Lcg {
+  public:
+    Lcg(unsigned seed) : state(seed) { }
+    double operator()() {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return double(state >> 11) * (1.0/9007199254740992.0);
+    }
+  private:
+    unsigned long long state;
+  };
+
+  template<class EventList>
+  double run(int n, unsigned seed, double & operations) {
+    EventList actions;
+    Lcg u(seed);
+    operations = 0.0;
+    unsigned long long seq = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      // initialisation
+      for (int age = 0; age <= 80; age += 5)
+	actions.insert(BenchAction(age, toBaselineUtility, seq++));
+      actions.insert(BenchAction(35.0 + 60.0*u(), toLocalised, seq++));
+      actions.insert(BenchAction(100.0*u(), toOtherDeath, seq++));
+      actions.insert(BenchAction(40.0 + 30.0*u(), toScreen, seq++));
+      operations += 20;
+      // main loop
+      while (!actions.empty()) {
+	BenchAction a = actions.pop_first();
+	++operations;
+	if (a.type() == toOtherDeath) {
+	  actions.clear();
+	  break;
+	}
+	switch (a.type()) {
+	case toScreen:
+	  actions.insert(BenchAction(a.time(), toUtilityChange, seq++));
+	  actions.insert(BenchAction(a.time() + 0.1, toUtilityChange, seq++));
+	  if (u() < 0.1)
+	    actions.insert(BenchAction(a.time(), toFollowUp, seq++));
+	  actions.insert(BenchAction(a.time() + 2.0 + 2.0*u(), toScreen, seq++));
+	  operations += 3;
+	  break;
+	case toLocalised:
+	case toFollowUp:
+	  actions.insert(BenchAction(a.time(), toUtilityChange, seq++));
+	  actions.insert(BenchAction(a.time() + 10.0*u(), toFollowUp, seq++));
+	  operations += 2;
+	  break;
+	default:
+	  break;
+	}
+      }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+
+  //! the same mix as a cProcess, through Sim
+  class BenchPerson : public cProcess {
+  public:
+    BenchPerson(Lcg & u, double & operations) : u(u), operations(operations) { }
+    void init() {
+      for (int age = 0; age <= 80; age += 5)
+	scheduleAt(age, toBaselineUtility);
+      scheduleAt(35.0 + 60.0*u(), toLocalised);
+      scheduleAt(100.0*u(), toOtherDeath);
+      scheduleAt(40.0 + 30.0*u(), toScreen);
+      operations += 20;
+    }
+    void handleMessage(const cMessage * msg) {
+      ++operations;
+      switch (msg->kind) {
+      case toOtherDeath:
+	Sim::stop_simulation();
+	break;
+      case toScreen:
+	scheduleAt(now(), toUtilityChange);
+	scheduleAt(now() + 0.1, toUtilityChange);
+	if (u() < 0.1)
+	  scheduleAt(now(), toFollowUp);
+	scheduleAt(now() + 2.0 + 2.0*u(), toScreen);
+	operations += 3;
+	break;
+      case toLocalised:
+      case toFollowUp:
+	scheduleAt(now(), toUtilityChange);
+	scheduleAt(now() + 10.0*u(), toFollowUp);
+	operations += 2;
+	break;
+      default:
+	break;
+      }
+    }
+  private:
+    Lcg & u;
+    double & operations;
+  };
+
+  double runSim(int n, unsigned seed, double & operations, KernelStats & stats) {
+    // a context of its own, so that the simulation of the caller is left alone
+    SimContext context;
+    SimContext::Scope scope(&context);
+    Lcg u(seed);
+    operations = 0.0;
+    BenchPerson person(u, operations);
+    Sim::reset_stats();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      Sim::create_process(&person);
+      Sim::run_simulation();
+      Sim::clear();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    stats = Sim::stats();
+    return elapsed.count();
+  }
+
+  RcppExport SEXP callKernelBenchmark(SEXP parms) {
+    Rcpp::List parmsl(parms);
+    int n = Rcpp::as<int>(parmsl["n"]);
+    unsigned seed = Rcpp::as<unsigned>(parmsl["seed"]);
+    vector<string> backend;
+    vector<double> operations(5), seconds(5);
+    KernelStats stats;
+    backend.push_back(heap<BenchAction>::name());
+    seconds[0] = run<heap<BenchAction> >(n, seed, operations[0]);
+    backend.push_back(dary_heap<BenchAction,4>::name());
+    seconds[1] = run<dary_heap<BenchAction,4> >(n, seed, operations[1]);
+    backend.push_back(pairing_heap<BenchAction>::name());
+    seconds[2] = run<pairing_heap<BenchAction> >(n, seed, operations[2]);
+    backend.push_back(radix_heap<BenchAction,BenchTimeKey>::name());
+    seconds[3] = run<radix_heap<BenchAction,BenchTimeKey> >(n, seed, operations[3]);
+    backend.push_back(string("Sim (") + Sim::event_list() + ")");
+    seconds[4] = runSim(n, seed, operations[4], stats);
+    return Rcpp::List::create(Rcpp::_("event_list") = string(Sim::event_list()),
+			      Rcpp::_("backends") = Rcpp::DataFrame::create(Rcpp::_("backend") = backend,
+									    Rcpp::_("operations") = operations,
+									    Rcpp::_("seconds") = seconds),
+			      Rcpp::_("out_of_order") = double(stats.out_of_order));
+  }
+
+} // namespace kernelBenchmark
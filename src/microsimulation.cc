@@ -20,11 +20,14 @@ namespace ssim {
   }
 
 
-  static Rng * default_stream, * current_stream;
-  static double rn = 0.0;
+  // the current stream is per thread, so that workers driving their
+  // own SimContext can each set() their own streams
+  static Rng * default_stream;
+  static thread_local Rng * current_stream = 0;
+  static thread_local double rn = 0.0;
 
   Rng::~Rng() {
-    if (current_stream->id == this->id)
+    if (current_stream != 0 && current_stream->id == this->id)
       current_stream = default_stream;
   }
 
@@ -149,6 +149,7 @@ namespace Rcpp {
 #include <siena/ssim.h>
 #include "RngStream.h"
 #include "rcpp_table.h"
+#include "serialize.h"
 
 #include <string>
 #include <algorithm>
@@ -179,47 +180,123 @@ using std::greater;
 /**
    @brief cMessage class for OMNET++ API compatibility.  This provides
    a heavier message class than Sim::Event, with short 'kind' and
-   std::string 'name' attributes.  The events by default are scheduled
+   'name' attributes.  The name is held as an interned symbol (see
+   Sim::symbol()), so a message is a few words and a kind-only message
+   costs no string.  The events by default are scheduled
    using cProcess::scheduleAt(), and handled using
    cProcess::handleMessage() (as per OMNET++).  NB:
    cProcess::scheduleAt() uses simulation time rather than time in
    state (which is used by Sim::self_signal_event()).
 */
+const unsigned short cMessageEventType = 1; // Event::type() of a cMessage
+
+/**
+   @brief cMessageName is the name of a cMessage, held as an interned symbol. It reads and
+   assigns like a std::string, so code using the name member of a cMessage keeps working.
+*/
+class cMessageName {
+public:
+  explicit cMessageName(const int s = -1) : symbol(s) { }
+  cMessageName & operator=(const string & n) { symbol = Sim::symbol(n); return *this; }
+  cMessageName & operator=(const char * n) { symbol = Sim::symbol(n); return *this; }
+  operator const string & () const { return Sim::symbol_name(symbol); }
+  const string & str() const { return Sim::symbol_name(symbol); }
+  const char * c_str() const { return str().c_str(); }
+  bool empty() const { return symbol < 0; }
+  int symbol; // interned name, -1 for none
+};
+
+inline bool operator==(const cMessageName & a, const cMessageName & b) { return a.symbol == b.symbol; }
+inline bool operator==(const cMessageName & a, const string & b) { return a.str() == b; }
+inline bool operator==(const string & a, const cMessageName & b) { return a == b.str(); }
+inline bool operator==(const cMessageName & a, const char * b) { return a.str() == b; }
+inline bool operator==(const char * a, const cMessageName & b) { return a == b.str(); }
+inline bool operator!=(const cMessageName & a, const cMessageName & b) { return !(a == b); }
+inline bool operator!=(const cMessageName & a, const string & b) { return !(a == b); }
+inline bool operator!=(const string & a, const cMessageName & b) { return !(a == b); }
+inline bool operator!=(const cMessageName & a, const char * b) { return !(a == b); }
+inline bool operator!=(const char * a, const cMessageName & b) { return !(a == b); }
+inline std::ostream & operator<<(std::ostream & os, const cMessageName & n) { return os << n.str(); }
+
 class cMessage : public ssim::Event {
 public:
- cMessage(const short k = -1, const string n = "") : kind(k), name(n), sendingTime(-1.0), timestamp(0) { }
+ cMessage(const short k = -1) : ssim::Event(cMessageEventType), kind(k), schedulePriority(0), name(-1), sendingTime(-1.0), timestamp(0) { }
+ cMessage(const short k, const string & n) : ssim::Event(cMessageEventType), kind(k), schedulePriority(0), name(Sim::symbol(n)), sendingTime(-1.0), timestamp(0) { }
+  // named with an already interned symbol (e.g. a static const int of the call site)
+ cMessage(const short k, const int symbol) : ssim::Event(cMessageEventType), kind(k), schedulePriority(0), name(symbol), sendingTime(-1.0), timestamp(0) { }
   // currently no setters (keep it lightweight?)
   short getKind() { return kind; }
-  string getName() { return name; }
+  // simultaneous messages are delivered by priority (lower values first), then in scheduling order
+  short getSchedulingPriority() { return schedulePriority; }
+  void setSchedulingPriority(short p) { schedulePriority = p; }
+  const string & getName() const { return name.str(); }
+  void setName(const string & n) { name = n; }
+  int getSymbol() const { return name.symbol; }
   Time getTimestamp() { return timestamp; }
   Time getSendingTime() {return sendingTime; }
   short kind;
-  string name;
+  short schedulePriority;
+  cMessageName name;
   Time sendingTime, timestamp;
   string str() const {
     std::ostringstream stringStream;
     stringStream << "kind=";
     stringStream << kind;
     stringStream << ",name=";
-    stringStream << name;
+    stringStream << getName();
     string str = stringStream.str();
     return str;
   }
-  // this does NOT include schedulePriority
+  // messages (and subclasses) are allocated from the arena of the current simulation context
+  static void * operator new(std::size_t size) { return Sim::allocate(size); }
+  static void operator delete(void * p) { Sim::deallocate(p); }
 };
 
+/**
+   @brief cPayloadMessage is a message with a kind and a small payload (a POD value or struct),
+   for models that would otherwise subclass cMessage for one field. It is scheduled with
+   cProcess::scheduleAt(Time, short, const T&) and read with payload<T>(msg).
+*/
+template<class T>
+class cPayloadMessage : public cMessage {
+public:
+  cPayloadMessage(const short k, const T & p) : cMessage(k), payload(p) { }
+  T payload;
+};
+
+/**
+   @brief payload returns the payload of a message scheduled as a cPayloadMessage<T>
+   (NB: the type is not checked)
+*/
+template<class T>
+inline const T & payload(const cMessage * msg) {
+  return static_cast<const cPayloadMessage<T> *>(msg)->payload;
+}
+
+/**
+   @brief asMessage returns the event as a cMessage, or 0 if it is not one (using the type
+   tag of the event rather than a dynamic_cast)
+*/
+inline const cMessage * asMessage(const ssim::Event * e) {
+  return (e != 0 && e->type() == cMessageEventType) ? static_cast<const cMessage *>(e) : 0;
+}
+
 inline bool cMessagePred(const ssim::Event* e, boost::function<bool(const cMessage * msg)> pred) {
-    const cMessage * msg = dynamic_cast<const cMessage *>(e);
+    const cMessage * msg = asMessage(e);
     return (msg != 0 && pred(msg));
   }
 
+ inline bool cMessageSymbolPred(const ssim::Event* e, const int symbol) {
+    const cMessage * msg = asMessage(e);
+    return (msg != 0 && msg->name.symbol == symbol);
+  }
+
  inline bool cMessageNamePred(const ssim::Event* e, const string s) {
-    const cMessage * msg = dynamic_cast<const cMessage *>(e);
-    return (msg != 0 && msg->name == s);
+    return cMessageSymbolPred(e, Sim::symbol(s));
   }
 
  inline bool cMessageKindPred(const ssim::Event* e, const short k) {
-    const cMessage * msg = dynamic_cast<const cMessage *>(e);
+    const cMessage * msg = asMessage(e);
     return (msg != 0 && msg->kind == k);
   }
 
@@ -236,7 +313,7 @@ public:
   virtual void handleMessage(const cMessage * msg) = 0;
   virtual void process_event(const ssim::Event * e) { // virtual or not?
     const cMessage * msg;
-    if ((msg = dynamic_cast<const cMessage *>(e)) != 0) {
+    if ((msg = asMessage(e)) != 0) {
       handleMessage(msg);
       previousEventTime = Sim::clock();
     } else {
@@ -244,33 +321,210 @@ public:
       REprintf("cProcess is only written to receive cMessage events\n");
     }
   }
-  virtual void scheduleAt(Time t, cMessage * msg) { // virtual or not?
+  /**
+     @brief handleMessages receives the messages due at the same time, in delivery order, when
+     batch delivery has been enabled with setBatchDelivery(). The default handles them one at a time.
+  */
+  virtual void handleMessages(const cMessage * const * msgs, unsigned n) {
+    for (unsigned i = 0; i < n; ++i) {
+      handleMessage(msgs[i]);
+      previousEventTime = Sim::clock();
+    }
+  }
+  virtual void process_batch(const ssim::Event * const * events, unsigned n) {
+    // the buffer is taken out of the object while in use, in case a
+    // handler runs a branch (Sim::run_branch()) that delivers a batch
+    vector<const cMessage *> msgs;
+    msgs.swap(batch);
+    msgs.clear();
+    for (unsigned i = 0; i < n; ++i) {
+      const cMessage * msg = asMessage(events[i]);
+      if (msg != 0)
+	msgs.push_back(msg);
+      else
+	REprintf("cProcess is only written to receive cMessage events\n");
+    }
+    if (!msgs.empty())
+      handleMessages(&msgs[0], msgs.size());
+    previousEventTime = Sim::clock();
+    msgs.swap(batch);
+  }
+  /**
+     @brief setBatchDelivery enables handleMessages() for this process (NB: call from init())
+  */
+  void setBatchDelivery(bool on = true) {
+    Sim::batch_events(on);
+  }
+  virtual EventHandle scheduleAt(Time t, cMessage * msg) { // virtual or not?
     msg->timestamp = t;
     msg->sendingTime = Sim::clock();
-    Sim::self_signal_event(msg, t - Sim::clock());
+    return Sim::self_signal_event(msg, t - Sim::clock(),
+				  EventTag(msg->kind, msg->name.symbol,
+					   msg->schedulePriority));
+  }
+  virtual EventHandle scheduleAt(Time t, string s) {
+    return scheduleAt(t, new cMessage(-1,s));
+  }
+  virtual EventHandle scheduleAt(Time t, short k) {
+    return scheduleAt(t, new cMessage(k));
   }
-  virtual void scheduleAt(Time t, string s) {
-    scheduleAt(t, new cMessage(-1,s));
+  /**
+     @brief scheduleAt schedules a message of the given kind that carries a payload
+     (see cPayloadMessage and payload()).
+  */
+  template<class T>
+  EventHandle scheduleAt(Time t, short k, const T & p) {
+    return scheduleAt(t, new cPayloadMessage<T>(k, p));
   }
-  virtual void scheduleAt(Time t, short k) {
-    scheduleAt(t, new cMessage(k,""));
+  /**
+     @brief scheduleEvery schedules a message at time start and then every period up to time stop,
+     using a single recurring timer (see Sim::self_signal_timer()). The same message is delivered
+     each time, and cancelEvent() on the returned handle stops the timer.
+  */
+  virtual EventHandle scheduleEvery(Time start, Time period, Time stop, cMessage * msg) {
+    msg->timestamp = start;
+    msg->sendingTime = Sim::clock();
+    return Sim::self_signal_timer(msg, start - Sim::clock(), period, stop,
+				  EventTag(msg->kind, msg->name.symbol,
+					   msg->schedulePriority));
+  }
+  virtual EventHandle scheduleEvery(Time start, Time period, Time stop, short k) {
+    return scheduleEvery(start, period, stop, new cMessage(k));
+  }
+  /**
+     @brief scheduleAll schedules a range of (time, message) pairs as scheduleAt(Time, cMessage*),
+     adding them to the event list in one pass (see Sim::self_signal_events()).
+  */
+  template<class InputIterator>
+  void scheduleAll(InputIterator first, InputIterator last) {
+    bulkEvents.clear(); bulkDelays.clear(); bulkTags.clear();
+    for (; first != last; ++first) {
+      Time t = first->first;
+      cMessage * msg = first->second;
+      msg->timestamp = t;
+      msg->sendingTime = Sim::clock();
+      bulkEvents.push_back(msg);
+      bulkDelays.push_back(t - Sim::clock());
+      bulkTags.push_back(EventTag(msg->kind, msg->name.symbol,
+				  msg->schedulePriority));
+    }
+    if (!bulkEvents.empty())
+      Sim::self_signal_events(&bulkEvents[0], &bulkDelays[0], &bulkTags[0],
+			      bulkEvents.size());
+  }
+  /**
+     @brief cancelEvent removes a message scheduled with scheduleAt() in constant time.
+     Returns false if the message has already been delivered or cancelled.
+  */
+  bool cancelEvent(EventHandle handle) {
+    return Sim::cancel_event(handle);
   }
 
   Time previousEventTime;
+ private:
+  vector<const cMessage *> batch;
+  vector<const ssim::Event *> bulkEvents;
+  vector<Time> bulkDelays;
+  vector<EventTag> bulkTags;
+};
+
+/**
+   @brief cProcessT is a cProcess that dispatches messages by kind to handler member functions,
+   with no RTTI and one indirect call per message. The model class derives from cProcessT<Model>
+   (CRTP) and lists its handlers, one per kind from 0, in a compile-time table. The table is
+   positional, so a static_assert next to it keeps it in step with the enum of kinds:
+
+   class Person : public cProcessT<Person> {
+   public:
+     void onset(const cMessage * msg);
+     void death(const cMessage * msg);
+     typedef Handlers<&Person::onset, &Person::death, &Person::death> handlers;
+     static_assert(toOnset == 0 && toDeath == 1 && toCancerDeath == 2 && handlers::size == nKinds,
+                   "handlers are listed in the order of the kinds");
+   };
+
+   Each handler is called from its own small function, so the compiler can inline it. Kinds
+   without a handler (nullptr in the table, or outside the table) go to unhandledMessage(),
+   which the model may redefine. Messages that reach handleMessage() (e.g. from
+   handleMessages()) are dispatched in the same way.
+*/
+template<class Derived>
+class cProcessT : public cProcess {
+public:
+  typedef void (Derived::*Handler)(const cMessage * msg);
+  template<Handler... Hs>
+  struct Handlers {
+    static const short size = sizeof...(Hs);
+  };
+  virtual void process_event(const ssim::Event * e) {
+    const cMessage * msg = asMessage(e);
+    if (msg != 0) {
+      dispatch(msg);
+      previousEventTime = Sim::clock();
+    } else
+      REprintf("cProcess is only written to receive cMessage events\n");
+  }
+  virtual void handleMessage(const cMessage * msg) {
+    dispatch(msg);
+  }
+  void unhandledMessage(const cMessage * msg) {
+    REprintf("No handler for kind %i\n", int(msg->kind));
+  }
+private:
+  typedef void (*Thunk)(Derived * self, const cMessage * msg);
+  template<Handler H>
+  static void thunk(Derived * self, const cMessage * msg) {
+    if (H != 0)
+      (self->*H)(msg);
+    else
+      self->unhandledMessage(msg);
+  }
+  template<Handler... Hs>
+  static const Thunk * table(Handlers<Hs...>) {
+    static const Thunk thunks[] = { &thunk<Hs>... };
+    return thunks;
+  }
+  void dispatch(const cMessage * msg) {
+    typedef typename Derived::handlers H;
+    Derived * self = static_cast<Derived *>(this);
+    if (msg->kind >= 0 && msg->kind < H::size)
+      table(H())[msg->kind](self, msg);
+    else
+      self->unhandledMessage(msg);
+  }
 };
 
 /**
-   @brief RemoveKind is a function to remove messages with the given kind from the queue (NB: void)
+   @brief RemoveKind is a function to remove messages with the given kind from the queue
+   of the current process (NB: void). This uses the kernel's per-process index, so it only
+   sees messages scheduled with cProcess::scheduleAt().
 */
  inline void RemoveKind(short kind) {
-   Sim::remove_event(boost::bind(cMessageKindPred,_1,kind));
+   Sim::remove_kind(Sim::this_process(), kind);
  }
 
  /**
-    @brief RemoveName is a function to remove messages with the given name from the queue (NB: void)
+    @brief RemoveName is a function to remove messages with the given name from the queue
+    of the current process (NB: void). See RemoveKind().
  */
  inline void RemoveName(string name) {
-   Sim::remove_event(boost::bind(cMessageNamePred,_1,name));
+   Sim::remove_symbol(Sim::this_process(), Sim::symbol(name));
+ }
+
+ /**
+    @brief PendingKind is a function to count the messages with the given kind in the queue
+    of the current process. See RemoveKind().
+ */
+ inline unsigned PendingKind(short kind) {
+   return Sim::pending_kind(Sim::this_process(), kind);
+ }
+
+ /**
+    @brief PendingName is a function to count the messages with the given name in the queue
+    of the current process. See RemoveKind().
+ */
+ inline unsigned PendingName(string name) {
+   return Sim::pending_symbol(Sim::this_process(), Sim::symbol(name));
  }
 
 
@@ -389,6 +643,40 @@ class Rng : public RngStream {
   }
   void set();
   void nextSubstream() { ResetNextSubstream(); }
+  /**
+      @brief save the stream state (current, substream and stream start), e.g. for a checkpoint
+  */
+  void save(std::ostream & out) const {
+    double cg[6], bg[6], ig[6];
+    GetFullState(cg, bg, ig);
+    for (int i = 0; i < 6; ++i) {
+      serialize::write(out, cg[i]); serialize::write(out, bg[i]); serialize::write(out, ig[i]);
+    }
+  }
+  /**
+      @brief restore a stream state written by save()
+  */
+  void load(std::istream & in) {
+    double cg[6], bg[6], ig[6];
+    for (int i = 0; i < 6; ++i) {
+      serialize::read(in, cg[i]); serialize::read(in, bg[i]); serialize::read(in, ig[i]);
+    }
+    SetFullState(cg, bg, ig);
+  }
+  /**
+      @brief in-memory stream state, e.g. to run a branch of a simulation (see Sim::run_branch())
+  */
+  struct State {
+    double cg[6], bg[6], ig[6];
+  };
+  State state() const {
+    State s;
+    GetFullState(s.cg, s.bg, s.ig);
+    return s;
+  }
+  void setState(const State & s) {
+    SetFullState(s.cg, s.bg, s.ig);
+  }
   int id;
 };
 
@@ -535,6 +823,22 @@ inline double discountedInterval(double start, double end, double discountRate)
    append_map<PtMap>(_pt,er._pt);
    append_map<UtilityMap>(_ut,er._ut);
  }
+ /**
+    @brief save the report (including its partition) in a binary format, e.g. for a checkpoint
+ */
+ void save(std::ostream & out) const {
+   using namespace serialize;
+   write(out, discountRate); write(out, outputUtilities); write(out, _partition);
+   write(out, _prev); write(out, _ut); write(out, _pt); write(out, _events);
+ }
+ /**
+    @brief restore a report written by save()
+ */
+ void load(std::istream & in) {
+   using namespace serialize;
+   read(in, discountRate); read(in, outputUtilities); read(in, _partition);
+   read(in, _prev); read(in, _ut); read(in, _pt); read(in, _events);
+ }
  SEXP wrap() {
    using namespace Rcpp;
    if (_events.size() == 0) return List::create();
@@ -548,6 +852,21 @@ inline double discountedInterval(double start, double end, double discountRate)
 			 _("events") = wrap_map(_events,"event","age","number"),
 			 _("prev") = wrap_map(_prev,"age","number"));
  }
+ /**
+    @brief wrap the report so far, e.g. at the end of each window of Sim::run_until().
+    With reset, the counts are then cleared (keeping the partition and the discount rate),
+    so that successive snapshots are increments of the report.
+ */
+ SEXP snapshot(bool reset = false) {
+   SEXP out = wrap();
+   if (reset) {
+     _ut.clear();
+     _pt.clear();
+     _events.clear();
+     _prev.clear();
+   }
+   return out;
+ }
  Utility discountRate;
  bool outputUtilities;
  Partition _partition;
@@ -597,6 +916,30 @@ inline double discountedInterval(double start, double end, double discountRate)
    using namespace Rcpp;
    return wrap_map(_table,"age","cost");
  }
+ /**
+    @brief wrap the costs so far; with reset, the table is then cleared (cf. EventReport::snapshot())
+ */
+ SEXP snapshot(bool reset = false) {
+   SEXP out = wrap();
+   if (reset) _table.clear();
+   return out;
+ }
+ /**
+    @brief save the report (including its partition) in a binary format, e.g. for a checkpoint
+ */
+ void save(std::ostream & out) const {
+   serialize::write(out, discountRate);
+   serialize::write(out, _partition);
+   serialize::write(out, _table);
+ }
+ /**
+    @brief restore a report written by save()
+ */
+ void load(std::istream & in) {
+   serialize::read(in, discountRate);
+   serialize::read(in, _partition);
+   serialize::read(in, _table);
+ }
  Cost discountRate;
  Partition _partition;
  boost::unordered_map<pair<State,Time>, Cost > _table;
@@ -637,6 +980,14 @@ inline double discountedInterval(double start, double end, double discountRate)
  SEXP wrap() {
    return Rcpp::wrap(_data);
  }
+ /**
+    @brief wrap the report data so far; with reset, the data are then cleared (cf. EventReport::snapshot())
+ */
+ SEXP snapshot(bool reset = false) {
+   SEXP out = wrap();
+   if (reset) _data.clear();
+   return out;
+ }
  /**
     @brief append another SimpleReport, which is useful for aggregating multiple reports.
  */
@@ -645,6 +996,14 @@ inline double discountedInterval(double start, double end, double discountRate)
      _data[it->first].insert(_data[it->first].end(), it->second.begin(), it->second.end());
    }
  }
+ /**
+    @brief save the report data in a binary format, e.g. for a checkpoint
+ */
+ void save(std::ostream & out) const { serialize::write(out, _data); }
+ /**
+    @brief restore report data written by save()
+ */
+ void load(std::istream & in) { serialize::read(in, _data); }
  /**
     @brief _data class member of a map from strings to vector<T>.
  */
@@ -27,6 +27,7 @@
 */
 
 #include "microsimulation.h"
+#include <chrono>
 
 namespace {
 
@@ -190,6 +191,16 @@ void Person::handleMessage(const cMessage* msg) {
 }
 
 
+  Process * newPerson(Person * person, int i) {
+    *person = Person(i);
+    return person;
+  }
+
+  void nextPerson(int) {
+    Person::rng["NH"]->nextSubstream();
+    Person::rng["S"]->nextSubstream();
+  }
+
 extern "C" {
 
   RcppExport SEXP callPersonSimulation(SEXP inseed, SEXP parms) {
@@ -207,15 +218,8 @@ extern "C" {
     Person::rng["S"] = new Rng();
     Person::rng["NH"]->set();
     Person person;
-    for (int i = 0; i < nin; i++) {
-      //Person::rng.foreach(nextSubStream);
-      Person::rng["NH"]->nextSubstream();
-      Person::rng["S"]->nextSubstream();
-      person = Person(i);
-      Sim::create_process(&person);
-      Sim::run_simulation();
-      Sim::clear();
-    }
+    nextPerson(0); // each person starts on new substreams
+    Sim::run_population(boost::bind(newPerson, &person, _1), nin, nextPerson);
     // tidy up -- what needs to be deleted?
     delete Person::rng["NH"];
     delete Person::rng["S"];
@@ -239,18 +243,24 @@ namespace {
     };
     virtual void handleMessage(const cMessage* msg) {};
   };
+
+  Process * verySimple(VerySimple * simple, int) {
+    *simple = VerySimple();
+    return simple;
+  }
   
 extern "C" {
 
-  RcppExport SEXP callSpeedTest() {
+  /**
+     Regression benchmark for the kernel: returns the number of persons simulated per second.
+  */
+  RcppExport SEXP callSpeedTest(SEXP nin) {
+    int n = Rcpp::as<int>(nin);
     VerySimple simple;
-    for (int i = 0; i < 1000000; i++) {
-      simple = VerySimple();      
-      Sim::create_process(&simple);
-      Sim::run_simulation();
-      Sim::clear();
-    }
-    return Rcpp::wrap(1);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Sim::run_population(boost::bind(verySimple, &simple, _1), n);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return Rcpp::wrap(n / elapsed.count());
     
   } // callSpeedTest()
   
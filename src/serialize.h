@@ -0,0 +1,209 @@
+/**
+ * @file serialize.h
+ * @author  Mark Clements <mark.clements@ki.se>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+
+ Compact binary serialization of the types used in the report classes:
+ arithmetic types, strings, pairs, boost tuples, and the standard and
+ boost containers of these. Values are written in native byte order,
+ so a file is only meant to be read back on the same platform (for
+ example, to checkpoint and resume a simulation).
+
+*/
+
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <boost/tuple/tuple.hpp>
+#include <boost/unordered_map.hpp>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <stdint.h>
+
+namespace ssim {
+
+  namespace serialize {
+
+    /**
+       @brief exception thrown when a stream cannot be read or written
+    */
+    class error : public std::runtime_error {
+    public:
+      error(const std::string & what) : std::runtime_error(what) { }
+    };
+
+    inline void check(const std::ios & s) {
+      if (!s) throw error("serialization: stream error");
+    }
+
+    // arithmetic types (and enums)
+    template<class T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    write(std::ostream & out, const T & x) {
+      out.write(reinterpret_cast<const char *>(&x), sizeof(T));
+      check(out);
+    }
+    template<class T>
+    typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    read(std::istream & in, T & x) {
+      in.read(reinterpret_cast<char *>(&x), sizeof(T));
+      check(in);
+    }
+
+    // sizes are always written as 64-bit integers
+    inline void write_size(std::ostream & out, size_t n) { write(out, uint64_t(n)); }
+    inline size_t read_size(std::istream & in) { uint64_t n; read(in, n); return size_t(n); }
+
+    inline void write(std::ostream & out, const std::string & s) {
+      write_size(out, s.size());
+      out.write(s.data(), s.size());
+      check(out);
+    }
+    inline void read(std::istream & in, std::string & s) {
+      s.resize(read_size(in));
+      if (!s.empty()) in.read(&s[0], s.size());
+      check(in);
+    }
+
+    // declarations, so that the templates below can call each other
+    template<class H, class T> void write(std::ostream &, const boost::tuples::cons<H,T> &);
+    template<class H, class T> void read(std::istream &, boost::tuples::cons<H,T> &);
+    template<class T1, class T2> void write(std::ostream &, const std::pair<T1,T2> &);
+    template<class T1, class T2> void read(std::istream &, std::pair<T1,T2> &);
+    template<class T, class A> void write(std::ostream &, const std::vector<T,A> &);
+    template<class T, class A> void read(std::istream &, std::vector<T,A> &);
+    template<class T, class C, class A> void write(std::ostream &, const std::set<T,C,A> &);
+    template<class T, class C, class A> void read(std::istream &, std::set<T,C,A> &);
+    template<class K, class V, class C, class A> void write(std::ostream &, const std::map<K,V,C,A> &);
+    template<class K, class V, class C, class A> void read(std::istream &, std::map<K,V,C,A> &);
+    template<class K, class V, class H, class P, class A>
+    void write(std::ostream &, const boost::unordered_map<K,V,H,P,A> &);
+    template<class K, class V, class H, class P, class A>
+    void read(std::istream &, boost::unordered_map<K,V,H,P,A> &);
+
+    // boost tuples, through their cons lists (the tail of the last element is returned by value)
+    inline void write(std::ostream &, const boost::tuples::null_type &) { }
+    inline void read(std::istream &, const boost::tuples::null_type &) { }
+    template<class H, class T>
+    void write(std::ostream & out, const boost::tuples::cons<H,T> & x) {
+      write(out, x.get_head());
+      write(out, x.get_tail());
+    }
+    template<class H, class T>
+    void read(std::istream & in, boost::tuples::cons<H,T> & x) {
+      read(in, x.get_head());
+      read(in, x.get_tail());
+    }
+
+    template<class T1, class T2>
+    void write(std::ostream & out, const std::pair<T1,T2> & x) {
+      write(out, x.first);
+      write(out, x.second);
+    }
+    template<class T1, class T2>
+    void read(std::istream & in, std::pair<T1,T2> & x) {
+      read(in, x.first);
+      read(in, x.second);
+    }
+
+    // sequences and associative containers: the size, then the elements
+    template<class C>
+    void write_elements(std::ostream & out, const C & c) {
+      write_size(out, c.size());
+      for (typename C::const_iterator it = c.begin(); it != c.end(); ++it)
+	write(out, *it);
+    }
+
+    template<class T, class A>
+    void write(std::ostream & out, const std::vector<T,A> & x) { write_elements(out, x); }
+    template<class T, class A>
+    void read(std::istream & in, std::vector<T,A> & x) {
+      x.resize(read_size(in));
+      for (typename std::vector<T,A>::iterator it = x.begin(); it != x.end(); ++it)
+	read(in, *it);
+    }
+
+    template<class T, class C, class A>
+    void write(std::ostream & out, const std::set<T,C,A> & x) { write_elements(out, x); }
+    template<class T, class C, class A>
+    void read(std::istream & in, std::set<T,C,A> & x) {
+      x.clear();
+      for (size_t n = read_size(in); n > 0; --n) {
+	T value;
+	read(in, value);
+	x.insert(x.end(), value);
+      }
+    }
+
+    template<class K, class V, class C, class A>
+    void write(std::ostream & out, const std::map<K,V,C,A> & x) { write_elements(out, x); }
+    template<class K, class V, class C, class A>
+    void read(std::istream & in, std::map<K,V,C,A> & x) {
+      x.clear();
+      for (size_t n = read_size(in); n > 0; --n) {
+	std::pair<K,V> value;
+	read(in, value);
+	x.insert(x.end(), value);
+      }
+    }
+
+    template<class K, class V, class H, class P, class A>
+    void write(std::ostream & out, const boost::unordered_map<K,V,H,P,A> & x) { write_elements(out, x); }
+    template<class K, class V, class H, class P, class A>
+    void read(std::istream & in, boost::unordered_map<K,V,H,P,A> & x) {
+      x.clear();
+      size_t n = read_size(in);
+      x.reserve(n);
+      for (; n > 0; --n) {
+	std::pair<K,V> value;
+	read(in, value);
+	x.insert(value);
+      }
+    }
+
+    /**
+       @brief writes a fixed-size tag, used to identify a file format or a section of a file
+    */
+    inline void write_tag(std::ostream & out, const char tag[8]) {
+      out.write(tag, 8);
+      check(out);
+    }
+    /**
+       @brief reads a tag written by write_tag() and throws an error if it does not match
+    */
+    inline void read_tag(std::istream & in, const char tag[8]) {
+      char buffer[8];
+      in.read(buffer, 8);
+      check(in);
+      if (!std::equal(buffer, buffer+8, tag))
+	throw error(std::string("serialization: expected ") + std::string(tag, 8));
+    }
+
+  } // namespace serialize
+
+} // namespace ssim
+
+#endif /* SERIALIZE_H */
@@ -0,0 +1,392 @@
+// -*-C++-*-
+//
+//  This file is part of SSim, a simple discrete-event simulator.
+//  See http://www.inf.usi.ch/carzaniga/ssim/
+//
+//  SSim is free software: you can redistribute it and/or modify it under
+//  the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your
+//  option) any later version.
+//
+//  SSim is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with SSim.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _coprocess_h
+#define _coprocess_h
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <initializer_list>
+#include <stdexcept>
+
+#include <siena/ssim.h>
+
+/** \file coprocess.h
+ *
+ *  This header file defines sequential processes written as C++20
+ *  coroutines.  It is empty unless the compiler supports coroutines.
+ *  The R package itself is built as C++11, so it is only compiled by
+ *  user code built as C++20 and by test/kernel/test-coprocess.
+ **/
+
+namespace ssim {
+
+/** @brief Virtual class representing sequential processes written as
+ *  coroutines.
+ *
+ *  Like a TProcess, a CoProcess implements its algorithm in a main()
+ *  body that waits for events, but main() is a coroutine that
+ *  suspends at each co_await instead of a thread of control with
+ *  its own stack.  A suspended process only keeps its coroutine
+ *  frames, which hold the local variables that live across a
+ *  co_await (typically a few hundred bytes), and the frames are
+ *  allocated from the arena of the current context (see
+ *  Sim::allocate()).  A CoProcess is an ordinary Process to the
+ *  simulator, so it coexists with reactive processes, and other
+ *  processes signal it with Sim::signal_event().
+ *
+ *  The body can wait for a delay, for any event, for the events
+ *  accepted by a predicate, and for the first of several competing
+ *  delays.  Parts of the body can be written as separate coroutines
+ *  that return a Task, and that the body awaits.  The process is
+ *  stopped when main() returns.
+ *
+ *  \code
+ *  class Person : public CoProcess {
+ *      virtual Task main() {
+ *          // competing risks: onset of the disease or other-cause death
+ *          Time risks[] = { rexp(0.01), rweibull(8, 80) };
+ *          switch (co_await first_of(risks, 2)) {
+ *          case 0:
+ *              co_await clinical();
+ *              break;
+ *          case 1:
+ *              record_death();
+ *              break;
+ *          }
+ *      }
+ *      Task clinical() {
+ *          // a screen (a cMessage of kind toScreen) or diagnosis
+ *          if (co_await wait_for_kind<cMessage>(toScreen, 5.0) == 0)
+ *              record_diagnosis();
+ *          co_await delay(1.0);
+ *          // ...
+ *      }
+ *  };
+ *  \endcode
+ *
+ *  An event is only valid until the body suspends again, as with
+ *  Process::process_event().  Events that arrive while the body
+ *  waits for something else, or after it returned, are passed to
+ *  unawaited().
+ *
+ *  @see TProcess
+ **/
+class CoProcess : public Process {
+public:
+    /** @brief return type of main() and of the coroutines it awaits. */
+    class Task {
+    public:
+	struct promise_type {
+	    std::coroutine_handle<> continuation;
+	    std::exception_ptr error;
+
+	    Task get_return_object() {
+		return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+	    }
+	    std::suspend_always initial_suspend() noexcept { return {}; }
+
+	    // resumes the awaiting coroutine, if any
+	    struct Final {
+		bool await_ready() noexcept { return false; }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+		    std::coroutine_handle<> c = h.promise().continuation;
+		    return c ? c : std::noop_coroutine();
+		}
+		void await_resume() noexcept {}
+	    };
+	    Final final_suspend() noexcept { return {}; }
+	    void return_void() {}
+	    void unhandled_exception() { error = std::current_exception(); }
+
+	    // frames are allocated from the arena of the current context
+	    static void * operator new(std::size_t size) { return Sim::allocate(size); }
+	    static void operator delete(void * p) { Sim::deallocate(p); }
+	};
+
+	Task(Task && t) noexcept : h(t.h) { t.h = nullptr; }
+	Task & operator=(Task && t) noexcept {
+	    if (this != &t) {
+		if (h)
+		    h.destroy();
+		h = t.h;
+		t.h = nullptr;
+	    }
+	    return *this;
+	}
+	~Task() { if (h) h.destroy(); }
+
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> parent) noexcept {
+	    h.promise().continuation = parent;
+	    return h;
+	}
+	void await_resume() const {
+	    if (h.promise().error)
+		std::rethrow_exception(h.promise().error);
+	}
+
+    private:
+	explicit Task(std::coroutine_handle<promise_type> c) : h(c) {}
+	Task() : h(nullptr) {}
+	std::coroutine_handle<promise_type> h;
+	friend class CoProcess;
+    };
+
+    /** @brief awaitable returned by delay(). */
+    class Delay {
+    public:
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> h) {
+	    p->suspend(h, AcceptNone, EventPredicate(), true, d);
+	}
+	void await_resume() const noexcept {}
+    private:
+	Delay(CoProcess * process, Time delay) : p(process), d(delay) {}
+	CoProcess * p;
+	Time d;
+	friend class CoProcess;
+    };
+
+    /** @brief awaitable returned by wait_for_event() and wait_for().
+     *
+     *  co_await yields the event, or 0 if the timeout expired.
+     **/
+    class Wait {
+    public:
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> h) {
+	    p->suspend(h, mode, accept, timeout != INIT_TIME, timeout);
+	}
+	const Event * await_resume() const noexcept { return p->received; }
+    private:
+	Wait(CoProcess * process, int m, const EventPredicate & pred, Time t)
+	    : p(process), mode(m), accept(pred), timeout(t) {}
+	CoProcess * p;
+	int mode;
+	EventPredicate accept;
+	Time timeout;
+	friend class CoProcess;
+    };
+
+    /** @brief awaitable returned by first_of().
+     *
+     *  co_await yields the index of the first delay to expire, or -1
+     *  if an accepted event arrived first (see event()).
+     **/
+    class FirstOf {
+    public:
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> h) {
+	    p->suspend(h, accept.empty() ? AcceptNone : AcceptIf, accept, true, d);
+	}
+	int await_resume() const noexcept { return p->received ? -1 : index; }
+    private:
+	FirstOf(CoProcess * process, int i, Time delay, const EventPredicate & pred)
+	    : p(process), index(i), d(delay), accept(pred) {}
+	CoProcess * p;
+	int index;
+	Time d;
+	EventPredicate accept;
+	friend class CoProcess;
+    };
+
+			CoProcess() : waiting(nullptr), mode(AcceptNone),
+				      wake(0), received(0) {}
+    virtual		~CoProcess() {}
+
+    /** @brief body of this process.
+     *
+     *  A coroutine that is started when the process is initialized
+     *  and runs until its first co_await.
+     **/
+    virtual Task	main() = 0;
+
+    /** @brief action executed for the events that the body does not
+     *  await.
+     *
+     *  The default implementation ignores the event.
+     **/
+    virtual void	unawaited(const Event *) {}
+
+    /** @brief suspends the body for the given delay. */
+    Delay		delay(Time d) { return Delay(this, d); }
+
+    /** @brief waits for the next event.
+     *
+     *  Same as TProcess::wait_for_event(): a (default) timeout of
+     *  \link ssim::INIT_TIME INIT_TIME\endlink means an infinite
+     *  timeout.  co_await yields the event, or 0 if the timeout
+     *  expired first.
+     **/
+    Wait		wait_for_event(Time timeout = INIT_TIME) {
+	return Wait(this, AcceptAny, EventPredicate(), timeout);
+    }
+
+    /** @brief waits for the next event accepted by the predicate.
+     *
+     *  Other events are passed to unawaited().
+     *
+     *  @see wait_for_event()
+     **/
+    Wait		wait_for(const EventPredicate & accept,
+				 Time timeout = INIT_TIME) {
+	return Wait(this, AcceptIf, accept, timeout);
+    }
+
+    /** @brief waits for the next event of class Message (or a
+     *  subclass) with the given kind member.
+     *
+     *  @see wait_for()
+     **/
+    template <class Message>
+    Wait		wait_for_kind(int kind, Time timeout = INIT_TIME) {
+	return wait_for([kind](const Event * e) {
+		const Message * m = dynamic_cast<const Message *>(e);
+		return m != 0 && m->kind == kind;
+	    }, timeout);
+    }
+
+    /** @brief waits for the first of competing delays.
+     *
+     *  Typically used for competing risks, with one delay per risk.
+     *  Only the shortest delay is scheduled.  co_await yields the
+     *  index of the shortest delay (the lowest one in case of ties),
+     *  or -1 if an event accepted by the (optional) predicate arrived
+     *  first, in which case event() returns that event.
+     *
+     *  @throws std::invalid_argument if there are no delays.
+     **/
+    FirstOf		first_of(const Time * delays, unsigned n,
+				 const EventPredicate & accept = EventPredicate()) {
+	if (n == 0)
+	    throw std::invalid_argument("ssim: first_of() called with no delays");
+	int index = 0;
+	for (unsigned i = 1; i < n; ++i)
+	    if (delays[i] < delays[index])
+		index = i;
+	return FirstOf(this, index, delays[index], accept);
+    }
+
+    /** @brief waits for the first of competing delays.
+     *
+     *  GCC (up to 12 at least) rejects a braced list within a
+     *  co_await expression, so bind the awaitable first:
+     *  <code>FirstOf f = first_of({ 3.0, 1.0 }); co_await f;</code>
+     *
+     *  @see first_of(const Time *, unsigned, const EventPredicate &)
+     **/
+    FirstOf		first_of(std::initializer_list<Time> delays,
+				 const EventPredicate & accept = EventPredicate()) {
+	return first_of(delays.begin(), delays.size(), accept);
+    }
+
+    /** @brief the event that resumed the body, or 0 after a delay or
+     *  timeout.
+     **/
+    const Event *	event() const { return received; }
+
+private:
+    enum { AcceptNone, AcceptAny, AcceptIf };
+
+    // internal event that ends a delay or timeout
+    class Wake : public Event {
+    public:
+	static void * operator new(std::size_t size) { return Sim::allocate(size); }
+	static void operator delete(void * p) { Sim::deallocate(p); }
+    };
+
+    virtual void	init(void) {
+	body = main();
+	resume(body.h);
+    }
+
+    virtual void	process_event(const Event * e) {
+	if (!waiting) {
+	    unawaited(e);
+	    return;
+	}
+	if (e != 0 && e == wake) {
+	    wake = 0;
+	    received = 0;
+	} else if (mode == AcceptAny || (mode == AcceptIf && accept(e))) {
+	    cancel_wake();
+	    received = e;
+	} else {
+	    unawaited(e);
+	    return;
+	}
+	std::coroutine_handle<> h = waiting;
+	waiting = nullptr;
+	resume(h);
+    }
+
+    virtual void	stop(void) {
+	// the body is suspended: discard its frames
+	cancel_wake();
+	waiting = nullptr;
+	body = Task();
+    }
+
+    void		suspend(std::coroutine_handle<> h, int m,
+				const EventPredicate & pred,
+				bool timed, Time timeout) {
+	waiting = h;
+	mode = m;
+	accept = pred;
+	received = 0;
+	if (timed) {
+	    wake = new Wake();
+	    wake_handle = Sim::self_signal_event(wake, timeout);
+	}
+    }
+
+    void		cancel_wake() {
+	if (wake) {
+	    Sim::cancel_event(wake_handle);
+	    wake = 0;
+	}
+    }
+
+    void		resume(std::coroutine_handle<> h) {
+	h.resume();
+	if (body.h && body.h.done()) {
+	    std::exception_ptr error = body.h.promise().error;
+	    body = Task();
+	    Sim::stop_process();
+	    if (error)
+		std::rethrow_exception(error);
+	}
+    }
+
+    Task			body;
+    std::coroutine_handle<>	waiting;
+    int				mode;
+    EventPredicate		accept;
+    const Event *		wake;
+    EventHandle			wake_handle;
+    const Event *		received;
+};
+
+}; // end namespace ssim
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* _coprocess_h */
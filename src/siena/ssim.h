@@ -27,6 +27,8 @@
 
 #include <boost/function.hpp>
 #include <string>
+#include <vector>
+#include <cstddef>
 
 /** \file ssim.h 
  *
@@ -110,18 +112,93 @@ const Time		INIT_TIME = 0;
  **/
 class Event {
  public:
-			Event(): refcount(0) {};
+			Event(): refcount(0), event_type(0) {};
     virtual		~Event() {};
     virtual std::string str() const { return "(event)"; };
 
+    /** @brief type tag of this event
+     *
+     *  A small integer given by the constructor of an event class, so
+     *  that a process can recognise the class of an event with a
+     *  comparison instead of a dynamic_cast.  Plain events have type
+     *  0.
+     **/
+    unsigned short	type() const { return event_type; }
+
+ protected:
+    /** @brief creates an event with the given type tag */
+			Event(unsigned short t): refcount(0), event_type(t) {};
+
  private:
     mutable unsigned refcount;
+    unsigned short event_type;
     friend class SimImpl;	// this is an opaque implementation class
     friend class Sim;		// these need to be friends to manage refcount
 };
 
   typedef boost::function<bool (const Event *)> EventPredicate;
 
+class Process;
+
+  typedef boost::function<Process * (int)> ProcessFactory;
+  typedef boost::function<void (int)> PopulationHook;
+  typedef boost::function<Time (int)> PopulationEntry;
+  typedef boost::function<void (Time)> ObservationHook;
+
+/** @brief handle to a scheduled event
+ *
+ *  Handles are returned by Sim::signal_event() and
+ *  Sim::self_signal_event(), and can be passed to
+ *  Sim::cancel_event() to cancel the event in constant time.  A
+ *  handle is a pair of small integers, so it can be copied freely.
+ *  It stays safe to use after the event has been delivered or
+ *  cancelled, and after Sim::clear(): it then simply refers to no
+ *  pending event.  A default-constructed handle refers to no event.
+ **/
+class EventHandle {
+public:
+			EventHandle() throw() : slot(~0u), generation(0) {}
+
+    bool		operator==(const EventHandle & h) const throw() {
+	return slot == h.slot && generation == h.generation;
+    }
+    bool		operator!=(const EventHandle & h) const throw() {
+	return !(*this == h);
+    }
+
+private:
+			EventHandle(unsigned s, unsigned g) throw() 
+			    : slot(s), generation(g) {}
+    unsigned slot;
+    unsigned generation;
+    friend class SimImpl;
+};
+
+/** @brief index keys and priority of a scheduled event
+ *
+ *  A tag gives a scheduled event a \em kind and a \em symbol (an
+ *  interned name, see Sim::symbol()).  The simulator keeps, for each
+ *  process, an index from kinds and symbols to the pending events,
+ *  so that all the pending events of a kind or symbol can be counted
+ *  or removed without scanning the schedule.  Negative values are not
+ *  indexed.
+ *
+ *  A tag also gives the schedule priority of the event.  Simultaneous
+ *  events are executed in order of priority (lower values first), and
+ *  then in the order in which they were scheduled.  The priority must
+ *  be in the range of a short.
+ *
+ *  @see Sim::remove_kind(), Sim::remove_symbol()
+ **/
+struct EventTag {
+    int kind;
+    int symbol;
+    int priority;
+
+    EventTag(int k = -1, int s = -1, int p = 0) throw() 
+	: kind(k), symbol(s), priority(p) {}
+};
+
 /** @brief Virtual class (interface) representing processes running
  *  within the simulator.
  *
@@ -197,6 +274,24 @@ class Process {
      **/
     virtual void	process_event(const Event * msg) {};
 
+    /** @brief action executed in response to a batch of events
+     *
+     *  A process that enabled Sim::batch_events() receives, in one
+     *  call, an event together with the events for the same process
+     *  that follow it in the schedule at the same time, in delivery
+     *  order.  The default implementation delivers them one at a
+     *  time with process_event().
+     *
+     *  @param events is an array of n events, which remain valid
+     *  until the method returns
+     *  @param n is the number of events (at least one)
+     **/
+    virtual void	process_batch(const Event * const * events, 
+				      unsigned n) {
+	for (unsigned i = 0; i < n; ++i)
+	    process_event(events[i]);
+    }
+
     /** @brief executed when the process is explicitly stopped.
      *
      *  A process is stopped by a call to
@@ -305,27 +400,270 @@ public:
     virtual void handle_terminated(ProcessId p, const Event * e) throw() {}
 };
 
+class SimImpl;
+
+/** @brief conditions for dumping the event trace
+ *
+ *  @see Sim::set_trace()
+ **/
+enum TraceDump {
+    /** @brief dump when Sim::stop_simulation() is called */
+    TRACE_DUMP_ON_STOP = 1,
+    /** @brief dump when an action is dropped because its process is
+     *  busy or terminated, or when a process throws an exception out
+     *  of the simulation */
+    TRACE_DUMP_ON_ERROR = 2
+};
+
+/** @brief counters of the simulator of a context
+ *
+ *  The counters are cumulative, from the creation of the context or
+ *  from the last Sim::reset_stats().  They are only collected if the
+ *  simulator is built with SSIM_STATS (the default); otherwise they
+ *  stay at zero.
+ *
+ *  @see Sim::stats()
+ **/
+struct KernelStats {
+    /** @brief actions taken from the schedule, including cancelled ones */
+    unsigned long long popped;
+    /** @brief actions executed */
+    unsigned long long executed;
+    /** @brief actions scheduled */
+    unsigned long long inserts;
+    /** @brief events cancelled with Sim::cancel_event() */
+    unsigned long long cancelled;
+    /** @brief events removed with Sim::remove_event(),
+     *  Sim::remove_kind() or Sim::remove_symbol() */
+    unsigned long long removed;
+    /** @brief actions dropped because their process was busy */
+    unsigned long long busy;
+    /** @brief actions dropped because their process was terminated */
+    unsigned long long terminated;
+    /** @brief actions scheduled before the time of an action already
+     *  taken from the schedule (with a negative delay).  The default
+     *  event list (radix) keeps these in a slower binary heap, so
+     *  this should stay 0 */
+    unsigned long long out_of_order;
+    /** @brief high-water mark of the schedule (including
+     *  cancelled actions not yet dropped) */
+    std::size_t max_queue;
+    /** @brief executed events by EventTag kind */
+    std::vector<unsigned long long> kinds;
+
+    KernelStats() throw() 
+	: popped(0), executed(0), inserts(0), cancelled(0), removed(0), 
+	  busy(0), terminated(0), out_of_order(0), max_queue(0) {}
+};
+
+/** @brief allocation counters of the event arena of a context
+ *
+ *  @see Sim::allocate(), Sim::arena_stats()
+ **/
+struct ArenaStats {
+    /** @brief blocks handed out by the arena */
+    unsigned long allocations;
+    /** @brief blocks returned to the arena */
+    unsigned long releases;
+    /** @brief calls to malloc, for chunks and for large blocks */
+    unsigned long system_allocations;
+    /** @brief wholesale resets, at Sim::clear() */
+    unsigned long resets;
+    /** @brief blocks currently allocated */
+    unsigned long live;
+    /** @brief bytes held in chunks */
+    std::size_t reserved;
+};
+
+/** @brief an independent simulation engine.
+ *
+ *  A SimContext owns its own schedule of actions, process table,
+ *  virtual clock and error handler.  The static Sim interface is a
+ *  facade over the context that is current for the calling thread.
+ *  A thread that never binds a context uses a default context of
+ *  its own, therefore the static Sim interface keeps working as a
+ *  single simulator for single-threaded programs.
+ *
+ *  To run several simulations concurrently, create one SimContext
+ *  per worker thread and bind it with a SimContext::Scope:
+ *
+ *  \code
+ *  void worker(Chunk * chunk) {
+ *      SimContext ctx;
+ *      SimContext::Scope scope(&ctx);
+ *      for (int i = 0; i < chunk->size(); ++i) {
+ *          Person person(chunk->id(i));
+ *          Sim::create_process(&person);
+ *          Sim::run_simulation();
+ *          Sim::clear();
+ *      }
+ *  }
+ *  \endcode
+ *
+ *  A context must not be shared by two threads at the same time, and
+ *  processes must only be created in, and signalled through, the
+ *  context that is current while they run.
+ **/
+class SimContext {
+public:
+    SimContext();
+    ~SimContext();
+
+    /** @brief context used by Sim in the calling thread */
+    static SimContext *	current() throw();
+
+    /** @brief binds a context to the calling thread
+     *
+     *  @param c is the new current context, or NULL to revert to the
+     *  default context of the calling thread.
+     *
+     *  @return the previously bound context.
+     **/
+    static SimContext *	set_current(SimContext * c) throw();
+
+    /** @brief binds a context to the calling thread for the lifetime
+     *  of this object, restoring the previous binding on exit.
+     **/
+    class Scope {
+    public:
+	Scope(SimContext * c) throw() : previous(set_current(c)) {}
+	~Scope() { set_current(previous); }
+    private:
+	Scope(const Scope &);
+	Scope & operator=(const Scope &);
+	SimContext * previous;
+    };
+
+private:
+    SimContext(const SimContext &);
+    SimContext & operator=(const SimContext &);
+
+    SimImpl * impl;
+    friend class Sim;
+    friend class SimImpl;
+    friend class ParallelImpl;
+};
+
+class ParallelImpl;
+
+/** @brief conservative parallel execution of one simulation
+ *
+ *  The processes of the simulation are partitioned over several
+ *  threads, each with its own SimContext, and they interact through
+ *  Sim::signal_event() as in a sequential simulation.  The lookahead
+ *  is the smallest delay of any event that a process signals to a
+ *  process of another partition.  The partitions advance together
+ *  in windows as wide as the lookahead (YAWNS), and the events for
+ *  other partitions are exchanged between the windows.
+ *
+ *  \code
+ *  ParallelSim psim(4, 1.0);		// 4 threads, lookahead of 1.0
+ *  ProcessId clinic = psim.create_process(0, &theClinic);
+ *  for (int i = 0; i < n; ++i)
+ *      psim.create_process(i % 4, person[i]);
+ *  psim.run();
+ *  \endcode
+ *
+ *  Process ids are global: Sim::this_process() and
+ *  Sim::create_process() return global ids, and Sim::signal_event()
+ *  accepts the id of any process.  The other operations on a process
+ *  id (such as Sim::stop_process(ProcessId) or Sim::remove_kind())
+ *  only apply to processes of the calling partition.
+ *
+ *  Each process sees its events in the same order as in a
+ *  sequential simulation, except for simultaneous events (same time
+ *  and priority) at a process when one of them comes from another
+ *  partition: local events are then delivered first, and events from
+ *  other partitions follow in order of sending time.  That order
+ *  does not depend on the timing of the threads, so parallel runs
+ *  are reproducible.  The histories of the processes are the same,
+ *  not the global order of execution: simultaneous events of
+ *  processes in different partitions run concurrently, so anything
+ *  that the processes share outside of events (e.g., a common report)
+ *  sees them in a different order than in a sequential run.
+ *
+ *  run() throws std::logic_error if one of the partitions is already
+ *  running a simulation (e.g., when called from a process).
+ *
+ *  An event signalled to another partition changes hands: it must
+ *  not be signalled to other processes as well, and the handle
+ *  returned by Sim::signal_event() refers to no event, so it cannot
+ *  be cancelled.  Sim::stop_simulation() ends the run at the end of
+ *  the current window.
+ **/
+class ParallelSim {
+public:
+    /** @brief creates the partitions
+     *
+     *  @param partitions is the number of partitions (threads)
+     *  @param lookahead is the positive minimum delay of events
+     *  between partitions
+     **/
+    ParallelSim(int partitions, Time lookahead);
+    ~ParallelSim();
+
+    int			partitions() const throw();
+    Time		lookahead() const throw();
+
+    /** @brief the context of a partition, e.g. to set an error handler */
+    SimContext *	context(int partition) throw();
+
+    /** @brief the partition of a (global) process id */
+    int			partition(ProcessId pid) const throw();
+
+    /** @brief creates a process in a partition
+     *
+     *  @return the global id of the new process
+     **/
+    ProcessId		create_process(int partition, Process * p);
+
+    /** @brief actions after this time are not executed
+     *
+     *  @see Sim::set_stop_time(Time)
+     **/
+    void		set_stop_time(Time t = INIT_TIME) throw();
+
+    /** @brief runs the simulation until there are no more actions,
+     *  the stop time, or Sim::stop_simulation()
+     *
+     *  The calling thread runs the first partition.  An exception
+     *  thrown by a process ends the run at the end of the window,
+     *  and is rethrown here.  An event signalled to another
+     *  partition with a delay shorter than the lookahead also ends
+     *  the run, with a std::logic_error.
+     **/
+    void		run();
+
+    /** @brief the number of windows of the last run */
+    unsigned long long	windows() const throw();
+
+private:
+    ParallelSim(const ParallelSim &);
+    ParallelSim & operator=(const ParallelSim &);
+
+    ParallelImpl * impl;
+};
+
 /** @brief a generic discrete-event sequential simulator
  *
  *  This class implements a generic discrete-event sequential
  *  simulator.  Sim maintains and executes a time-ordered schedule of
- *  actions (or discrete events).  
+ *  actions (or discrete events).  Simultaneous actions are executed
+ *  by priority (see EventTag) and then in the order in which they
+ *  were scheduled, so runs are reproducible whatever the event list
+ *  backend.
  *
  *  Notice that this class is designed to have only static members.
  *  It should therefore be seen and used more as a module than a
- *  class.  In practice, this means that Sim <em>does not define
- *  simulation objects</em>, but rather a single, static simulator.
- *  This design is based on practical considerations: a simulation
- *  object would allow one to handle multiple simulations within the
- *  same program at the same time, however that situation is neither
- *  common nor desirable.  Simulations tend to use a lot of memory and
- *  therefore having many of them is probably a bad idea.  Also,
- *  having multiple simulation objects would require every process
- *  object to maintain a reference to the corresponding simulation
- *  context (object), so that processes can access the virtual clock
- *  of their own simulation, their scheduler, etc.  This is both a
- *  waste of memory, for the many aditional references, and of CPU
- *  time for all the indirect calls to the simulation methods.
+ *  class.  Processes do not need to maintain a reference to their
+ *  simulation: every static method operates on the \link
+ *  SimContext::current() current context\endlink of the calling
+ *  thread.  By default, each thread uses its own default context,
+ *  so a single-threaded program sees a single, static simulator.
+ *  Independent simulations can be run side by side by binding a
+ *  different SimContext to each worker thread.
+ *
+ *  @see SimContext
  **/ 
 class Sim {
 public:
@@ -348,6 +686,19 @@ public:
     /** @brief stops the execution of the current process */
     static void		stop_process() throw();
 
+    /** @brief enables batch delivery for the current process
+     *
+     *  Events due at the same time for the current process are then
+     *  popped from the schedule in bulk and delivered together with
+     *  Process::process_batch().  The batch is the run of events for
+     *  the process at the front of the schedule, so events scheduled
+     *  while handling the batch come in a later batch, and the events
+     *  of the batch can no longer be cancelled.  Likewise, a call to
+     *  stop_simulation() takes effect at the end of the batch.
+     *  Typically called from Process::init().
+     **/
+    static void		batch_events(bool on = true) throw();
+
    /** @brief clears out internal data structures
     *
     *  Resets the simulator making it available for a completely new
@@ -360,6 +711,91 @@ public:
     **/
     static void		clear() throw();
 
+    /** @brief runs one simulation for each individual of a population
+     *
+     *  This is equivalent to, but faster than, the usual loop
+     *
+     *  \code
+     *  for (int i = 0; i < n; ++i) {
+     *      Sim::create_process(factory(i));
+     *      Sim::run_simulation();
+     *      Sim::clear();
+     *      hook(i);
+     *  }
+     *  \endcode
+     *
+     *  The clock, the schedule and the process table are reset in
+     *  place between individuals, so the simulator keeps its
+     *  capacity, and each process is initialised directly in a
+     *  single process slot.  Processes created by an individual
+     *  (with create_process()) are dropped with it.
+     *
+     *  @param factory returns the process of the i-th individual.  It
+     *  typically re-initialises and returns the same object.
+     *
+     *  @param n is the number of individuals
+     *
+     *  @param hook (optional) is called after the simulation of each
+     *  individual, once the simulator has been cleared.  This is the
+     *  place to advance random number substreams or to check for
+     *  user interrupts.
+     *
+     *  @throws std::logic_error if called while a simulation is
+     *  running in this context (e.g., from a process).
+     **/
+    static void		run_population(ProcessFactory factory, int n, 
+				       PopulationHook hook = PopulationHook());
+
+    /** @brief runs a whole population concurrently on one schedule
+     *
+     *  Unlike run_population(), all the individuals share the
+     *  clock and the schedule, so that they can interact, e.g.
+     *  through shared resources in calendar time.  The individuals
+     *  enter the simulation in order: the i-th process is created
+     *  with factory(i) at time entry(i), and initialised at that
+     *  time.  Only one arrival is scheduled at a time, so the
+     *  schedule and the process table hold the individuals that are
+     *  alive at the same time rather than the whole population.
+     *
+     *  An individual leaves the simulation with stop_process()
+     *  (rather than stop_simulation(), which stops everyone).  Its
+     *  process id is recycled for a later individual once none of
+     *  its actions remain in the schedule, so process ids must not be
+     *  kept after a process has stopped.  The simulation ends when
+     *  the schedule is empty, or at the stop time.
+     *
+     *  @param factory returns the process of the i-th individual.
+     *  The process must stay valid until departure(i) is called.
+     *
+     *  @param n is the number of individuals
+     *
+     *  @param entry (optional) is the entry time of the i-th
+     *  individual, non-decreasing in i.  By default, everyone enters
+     *  at time 0.
+     *
+     *  @param departure (optional) is called with i when the i-th
+     *  individual has stopped, e.g. to delete its process.
+     *
+     *  @throws std::logic_error if called while a simulation is
+     *  running in this context.
+     **/
+    static void		run_concurrent(ProcessFactory factory, int n, 
+				       PopulationEntry entry = PopulationEntry(),
+				       PopulationHook departure = PopulationHook());
+
+    /** @brief schedules a population as in run_concurrent(),
+     *  without running it
+     *
+     *  The simulation can then be run in windows with run_until(),
+     *  e.g. to collect yearly reports.  Sim::clear() ends the
+     *  population mode.
+     *
+     *  @see run_concurrent()
+     **/
+    static void		create_population(ProcessFactory factory, int n, 
+					  PopulationEntry entry = PopulationEntry(),
+					  PopulationHook departure = PopulationHook());
+
     /** @brief signal an event to the current process immediately
      *
      *  Signal an event to \link this_process() this
@@ -371,10 +807,12 @@ public:
      *
      *  @param e is the signaled event (possibly NULL)
      *
+     *  @return a handle that can be passed to cancel_event()
+     *
      *  @see signal_event(ProcessId, const Event *)
      *       and Process::process_event(const Event *).
      **/
-    static void		self_signal_event(const Event * e) throw();
+    static EventHandle	self_signal_event(const Event * e) throw();
 
     /** @brief signal an event to the current process at the given time 
      *
@@ -389,10 +827,12 @@ public:
      *  @param delay is the delay from the \link Sim::clock() current
      *  time\endlink
      *
+     *  @return a handle that can be passed to cancel_event()
+     *
      *  @see signal_event() 
      *       and Process::process_event(const Event *).
      **/
-    static void		self_signal_event(const Event * e, Time delay) throw();
+    static EventHandle	self_signal_event(const Event * e, Time delay) throw();
 
     /** @brief signal an event to the given process immediately
      *
@@ -410,10 +850,12 @@ public:
      *
      *  @param e is the signaled event (possibly NULL)
      *
+     *  @return a handle that can be passed to cancel_event()
+     *
      *  @see self_signal_event() 
      *       and Process::process_event(ProcessId, const Event *).
      **/
-    static void		signal_event(ProcessId p, const Event * e) throw();
+    static EventHandle	signal_event(ProcessId p, const Event * e) throw();
 
     /** @brief signal an event to the given process at the given time 
      *
@@ -433,10 +875,81 @@ public:
      *  @param d is the signal delay starting from the \link
      *  Sim::clock() current time\endlink
      *
+     *  @return a handle that can be passed to cancel_event()
+     *
      *  @see self_signal_event() 
      *       and Process::process_event(const Event *).
      **/
-    static void		signal_event(ProcessId p, const Event * e, Time d) throw();
+    static EventHandle	signal_event(ProcessId p, const Event * e, Time d) throw();
+
+    /** @brief signal a tagged event to the current process
+     *
+     *  Same as self_signal_event(const Event*, Time), except that the
+     *  event is indexed under the kind and symbol of the given tag.
+     *
+     *  @see EventTag, remove_kind(), remove_symbol()
+     **/
+    static EventHandle	self_signal_event(const Event * e, Time delay, 
+					  EventTag tag) throw();
+
+    /** @brief signal a tagged event to the given process
+     *
+     *  Same as signal_event(ProcessId, const Event*, Time), except
+     *  that the event is indexed under the kind and symbol of the
+     *  given tag.
+     *
+     *  @see EventTag, remove_kind(), remove_symbol()
+     **/
+    static EventHandle	signal_event(ProcessId p, const Event * e, Time d,
+				     EventTag tag) throw();
+
+    /** @brief signal a recurring event to the current process
+     *
+     *  Schedules the event with the given delay, as
+     *  self_signal_event(const Event*, Time, EventTag), and then
+     *  again every period, as long as the time of the next firing is
+     *  not later than stop.  The timer holds a single entry in the
+     *  schedule, which is re-armed when it fires (before the event
+     *  is delivered), so the returned handle stays pending until the
+     *  last firing, and cancel_event() stops the timer in constant
+     *  time.  The same event is delivered at every firing.
+     *
+     *  @param e is the signaled event (possibly NULL)
+     *  @param delay is the delay of the first firing from the
+     *  \link Sim::clock() current time\endlink
+     *  @param period is the time between firings.  With a period
+     *  that is not positive, the event is signaled once.
+     *  @param stop is the latest time of a firing
+     *  @param tag is the tag of the event
+     *
+     *  @return a handle that can be passed to cancel_event()
+     *
+     *  @see self_signal_event(const Event*, Time, EventTag)
+     **/
+    static EventHandle	self_signal_timer(const Event * e, Time delay,
+					  Time period, Time stop,
+					  EventTag tag = EventTag()) throw();
+
+    /** @brief signal a batch of events to the current process
+     *
+     *  Same as calling self_signal_event(const Event*, Time,
+     *  EventTag) for each event in turn, but the events are added
+     *  to the schedule together, which restores the order of the
+     *  event list in one pass.  Typically used to schedule the
+     *  initial events of a process in Process::init().
+     *
+     *  @param events are the n signaled events
+     *  @param delays are the n delays from the current time
+     *  @param tags are the n tags of the events, or NULL for untagged
+     *  events
+     *  @param n is the number of events
+     *  @param handles receives the n handles of the events, unless
+     *  it is NULL
+     **/
+    static void		self_signal_events(const Event * const * events,
+					   const Time * delays,
+					   const EventTag * tags, unsigned n,
+					   EventHandle * handles = 0) throw();
 
     /** @brief advance the execution time of the current process.
      *
@@ -561,6 +1074,91 @@ public:
     
     /** @brief starts execution of the simulation */
     static void		run_simulation();
+
+    /** @brief runs the simulation up to a given time
+     *
+     *  Executes the actions scheduled up to and including time t,
+     *  and then pauses.  The later actions stay scheduled, and the
+     *  clock is set to t, or to the stop time if that is earlier
+     *  (unless the simulation was stopped with stop_simulation()
+     *  first), so that reports can be collected at t before the
+     *  simulation carries on, e.g. yearly:
+     *
+     *  \code
+     *  for (Time t = 1.0; Sim::run_until(t); t += 1.0)
+     *      snapshots.push_back(report.snapshot());
+     *  snapshots.push_back(report.snapshot());	// the last year
+     *  \endcode
+     *
+     *  @return true if the simulation can carry on: actions (other
+     *  than cancelled ones) or observations (see observe()) remain
+     *  after t, up to the stop time, and stop_simulation() was not
+     *  called
+     *  @see resume()
+     **/
+    static bool		run_until(Time t);
+
+    /** @brief carries on with a simulation paused by run_until(),
+     *  stop_simulation() or the stop time, up to its end
+     **/
+    static void		resume();
+
+    /** @brief registers observation times for the current process
+     *
+     *  The hook is called with each of the given times, in
+     *  increasing order, as the simulation reaches them: the clock
+     *  is set to the observation time, and the hook runs as the
+     *  current process, before any action at the same time.
+     *  Observations are not actions, so they take no room in the
+     *  schedule.  They stop with the simulation (stop_simulation(),
+     *  the stop time or the end of a run_until() window, after
+     *  which they resume) and are removed when the process stops,
+     *  so a hook never runs after departure() (see run_concurrent())
+     *  or for a later process with the same id.  When no action is left, the remaining observations
+     *  are made in turn.  Observers are dropped by clear().
+     *
+     *  @param times are the observation times, in increasing order.
+     *  Times before the current time are ignored.
+     *  @param hook is called with each observation time
+     *
+     *  @return an identifier for remove_observer()
+     **/
+    static int		observe(const std::vector<Time> & times,
+				const ObservationHook & hook);
+
+    /** @brief cancels the remaining observations of an observer
+     *
+     *  @param id is the identifier returned by observe()
+     **/
+    static void		remove_observer(int id) throw();
+
+    /** @brief runs a branch of the simulation from the current state
+     *
+     *  Saves the schedule, the process table and the clock, calls
+     *  setup(), which can signal and cancel events as the current
+     *  process, and then runs the branch until its schedule is
+     *  empty or stop_simulation() is called.  The saved state is then
+     *  restored, so the simulation carries on as if the branch had
+     *  never run.  The pending events are shared between the
+     *  branch and the saved state, not copied, so the cost of a
+     *  branch is that of copying the schedule, which is small for
+     *  a simulation of one individual.
+     *
+     *  Can be called from Process::process_event() or between runs
+     *  (e.g., after run_until()), and repeatedly to run several
+     *  branches from the same state.  The kernel does not know the
+     *  state of the processes: a process that changes in the
+     *  branch (including the positions of its random number
+     *  streams) must save and restore itself around the call.
+     *  Handles obtained in the branch are not valid afterwards.
+     *  Branches are meant for contexts of a single individual, not
+     *  for ParallelSim or processes created in the branch.
+     *
+     *  @param setup prepares the branch, e.g. by removing a
+     *  scheduled treatment and signaling another one
+     **/
+    static void		run_branch(const boost::function<void()> & setup);
+
     /** @brief stops execution of the simulation */
     static void		stop_simulation() throw();
 
@@ -572,9 +1170,10 @@ public:
      *  schedulable actions.  When called with the (default)
      *  INIT_TIME, the simulation is set for normal termination, that
      *  is, the simulation terminates in the absence of schedulable
-     *  actions.
+     *  actions.  Actions after the stop time stay scheduled, so the
+     *  simulation can be resumed with a later stop time.
      *
-     *  @see stop_simulation()
+     *  @see stop_simulation(), run_until(Time)
      **/
     static void		set_stop_time(Time t = INIT_TIME) throw();
 
@@ -586,7 +1185,178 @@ public:
      *  @see SimErrorHandler
      **/
     static void		set_error_handler(SimErrorHandler *) throw();
-    static void remove_event(EventPredicate pred) throw();
+
+    /** @brief cancels a scheduled event
+     *
+     *  The event is released as if it had been processed.  This
+     *  takes constant time: the action is only marked as cancelled,
+     *  and it is dropped when it reaches the head of the schedule, or
+     *  when cancelled actions make up most of the schedule.
+     *
+     *  @param h is a handle returned by signal_event() or
+     *  self_signal_event()
+     *
+     *  @return true if the event was pending and has been cancelled,
+     *  false if it had already been delivered or cancelled.
+     **/
+    static bool		cancel_event(EventHandle h) throw();
+
+    /** @brief tells whether an event is still scheduled
+     *
+     *  @param h is a handle returned by signal_event() or
+     *  self_signal_event()
+     **/
+    static bool		pending(EventHandle h) throw();
+
+    /** @brief removes the scheduled events that satisfy a predicate
+     *
+     *  The removed events are released as if they had been processed.
+     *  This method scans the whole schedule of actions; prefer
+     *  cancel_event() when the handle of the event is known.
+     **/
+    static void		remove_event(EventPredicate pred) throw();
+
+    /** @brief removes the pending events of the given kind
+     *
+     *  Only the events scheduled with an EventTag are indexed.  This
+     *  method only touches the removed events.
+     *
+     *  @param p is the destination process of the events
+     *  @param kind is the kind given in the EventTag of the events
+     *
+     *  @return the number of removed events
+     **/
+    static unsigned	remove_kind(ProcessId p, int kind) throw();
+
+    /** @brief removes the pending events with the given symbol
+     *
+     *  @see remove_kind(), symbol()
+     **/
+    static unsigned	remove_symbol(ProcessId p, int symbol) throw();
+
+    /** @brief number of pending events of the given kind
+     *
+     *  @see remove_kind()
+     **/
+    static unsigned	pending_kind(ProcessId p, int kind) throw();
+
+    /** @brief number of pending events with the given symbol
+     *
+     *  @see remove_symbol()
+     **/
+    static unsigned	pending_symbol(ProcessId p, int symbol) throw();
+
+    /** @brief interns a name
+     *
+     *  Symbols are small non-negative integers that identify names.
+     *  The same name always maps to the same symbol, in every
+     *  context and thread of the program.  The empty name maps to -1,
+     *  which is never indexed.  Each thread caches the names it
+     *  interned, so only the first lookup of a name in a thread
+     *  locks the (global) symbol table.
+     *
+     *  @throws std::length_error if the table is full (over four
+     *  million names).
+     **/
+    static int		symbol(const std::string & name);
+
+    /** @brief name of an interned symbol
+     *
+     *  Takes no lock.  The name stays valid for the lifetime of the
+     *  program; the name of -1 (or of any other non-symbol) is empty.
+     *
+     *  @see symbol()
+     **/
+    static const std::string & symbol_name(int symbol);
+
+    /** @brief allocates memory for an event
+     *
+     *  Events may be allocated from the arena of the current context
+     *  by defining their class operator new and operator delete with
+     *  allocate() and deallocate().  Small blocks are recycled
+     *  through per-size free lists, and the arena is reset wholesale
+     *  by clear() when no block is live, so in steady state events
+     *  cost no call to malloc.
+     *
+     *  A block must be deallocated in the thread that runs the
+     *  context that allocated it.
+     *
+     *  @see ArenaStats
+     **/
+    static void *	allocate(std::size_t size);
+
+    /** @brief returns a block to the arena that allocated it
+     *
+     *  @see allocate()
+     **/
+    static void		deallocate(void * p) throw();
+
+    /** @brief allocation counters of the arena of the current context */
+    static const ArenaStats & arena_stats() throw();
+
+    /** @brief zeroes the cumulative counters of arena_stats() */
+    static void		reset_arena_stats() throw();
+
+    /** @brief statistics of the simulator of the current context 
+     *
+     *  @see KernelStats
+     **/
+    static const KernelStats & stats() throw();
+
+    /** @brief zeroes the statistics of the current context */
+    static void		reset_stats() throw();
+
+    /** @brief enables the event trace of the current context
+     *
+     *  The trace is a ring buffer that keeps the last \em capacity
+     *  executed actions, each with the id of the current individual,
+     *  the time, the EventTag kind (-1 for untagged actions), the
+     *  process id and the size of the schedule.  The trace is
+     *  disabled by default, in which case it costs a single test per
+     *  action.
+     *
+     *  @param capacity is the number of records kept, or 0 to
+     *  disable the trace
+     *
+     *  @param file is the file written by dump_trace() by default,
+     *  and when the conditions given by flags occur
+     *
+     *  @param flags is a combination of TraceDump values
+     *
+     *  @see dump_trace(), set_trace_person()
+     **/
+    static void		set_trace(std::size_t capacity, 
+				  const std::string & file = std::string(),
+				  int flags = 0);
+
+    /** @brief sets the id of the current individual in the trace
+     *
+     *  run_population() sets it to the index of each individual.
+     **/
+    static void		set_trace_person(int id) throw();
+
+    /** @brief writes the event trace to a binary file
+     *
+     *  The file holds an 8-byte magic string ("SSIMTRC1"), the
+     *  number of records n as a 32-bit integer, and then the records
+     *  column by column, oldest first: n 32-bit person ids, n double
+     *  times, n 32-bit kinds, n 32-bit process ids and n 32-bit
+     *  schedule sizes, in native byte order.
+     *
+     *  @param file is the output file, or the empty string for the
+     *  file given to set_trace()
+     *
+     *  @return true on success
+     **/
+    static bool		dump_trace(const std::string & file = std::string()) throw();
+
+    /** @brief name of the event list backend
+     *
+     *  The event list (the time-ordered schedule of actions) is
+     *  selected at build time by defining SSIM_EVENT_LIST.  This
+     *  method returns "binary", "dary", "pairing" or "radix".
+     **/
+    static const char *	event_list() throw();
 };
   void Rprint_actions();
 
@@ -0,0 +1,73 @@
+// -*-C++-*-
+//
+//  This file is part of SSim, a simple discrete-event simulator.
+//  See http://www.inf.usi.ch/carzaniga/ssim/
+//
+//  SSim is free software: you can redistribute it and/or modify it under
+//  the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your
+//  option) any later version.
+//
+//  SSim is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with SSim.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _tcontext_h
+#define _tcontext_h
+
+/** \file tcontext.h
+ *
+ *  This header file declares the native execution contexts used by
+ *  TProcess when TPROCESS_IMPL is 3.
+ **/
+
+#if !defined(_WIN32) && (defined(__x86_64__) || defined(__aarch64__))
+/** @brief defined as 1 when native contexts are available on this target. */
+#define SSIM_NATIVE_TCONTEXT 1
+#else
+#define SSIM_NATIVE_TCONTEXT 0
+#endif
+
+#if SSIM_NATIVE_TCONTEXT
+
+namespace ssim {
+
+/** @brief saved execution context.
+ *
+ *  A context is the stack pointer of a suspended stack.  The
+ *  callee-saved registers and the return address are stored on that
+ *  stack by tcontext_switch().
+ **/
+typedef void * tcontext_t;
+
+/** @brief creates a context that runs entry(arg) on the given stack.
+ *
+ *  The context starts running at the first tcontext_switch() to it.
+ *  entry must never return: it must switch away for the last time
+ *  instead.
+ **/
+tcontext_t tcontext_make(char * stack, unsigned long size,
+			 void (*entry)(void *), void * arg);
+
+/** @brief suspends the current context into *from and resumes to.
+ *
+ *  This is a plain function call that saves and restores the
+ *  callee-saved registers and the stack pointer.  Unlike
+ *  swapcontext() it does not save the signal mask, so no system call
+ *  is made.
+ **/
+extern "C" void ssim_tcontext_switch(tcontext_t * from, tcontext_t to);
+
+inline void tcontext_switch(tcontext_t * from, tcontext_t to) {
+    ssim_tcontext_switch(from, to);
+}
+
+}; // end namespace ssim
+
+#endif /* SSIM_NATIVE_TCONTEXT */
+
+#endif /* _tcontext_h */
@@ -30,12 +30,16 @@
 #endif
 
 // to make OSX happy with using ucontext.h
+#ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE
+#endif
 
 #if TPROCESS_IMPL != 0
 
 #if TPROCESS_IMPL==1
 #include <ucontext.h>
+#elif TPROCESS_IMPL==3
+#include <siena/tcontext.h>
 #else
 #include <setjmp.h>
 #endif
@@ -92,9 +96,54 @@ public:
      *
      *  The initial value is 8Kb.  This value can be dynamically
      *  adjusted, and will affect all newly created TProcess objects.
+     *  Stack sizes are rounded up to a multiple of the page size.
      **/
     static unsigned long DefaultStackSize;
 
+    /** @brief whether stacks are protected by a guard page.
+     *
+     *  When true (the default), the page below each stack is mapped
+     *  without access rights, so that a stack overflow faults
+     *  instead of silently overwriting other memory.  Each guarded
+     *  stack takes two memory mappings, which limits the number of
+     *  concurrent processes to about half the system limit on
+     *  mappings (vm.max_map_count on Linux, 65530 by default).
+     *  Unguarded stacks are mapped in chunks.  When no guard page
+     *  can be mapped, this value is reset to false.  This value
+     *  affects stacks mapped afterwards.
+     **/
+    static bool StackGuard;
+
+    /** @brief number of stacks currently held by processes.
+     *
+     *  A process takes a stack from a pool of stacks of its size
+     *  when it is initialized, and gives it back when it is stopped
+     *  or destroyed, so a stack is reused by later processes.
+     **/
+    static unsigned long stacks_in_use();
+
+    /** @brief number of stacks mapped, in use or pooled. */
+    static unsigned long stacks_mapped();
+
+    /** @brief the deepest stack usage seen, in bytes.
+     *
+     *  The usage of a stack is measured when it goes back to the
+     *  pool, as the extent of the memory written from the top of the
+     *  stack.  A stack size (or DefaultStackSize) a comfortable
+     *  margin above this value is safe for the same model.
+     **/
+    static unsigned long stack_high_water();
+
+    /** @brief restarts the measure of stack_high_water(), e.g.
+     *  before running another model.
+     **/
+    static void reset_stack_high_water();
+
+    /** @brief unmaps the pooled stacks of the sizes that have no
+     *  stack in use.
+     **/
+    static void release_stacks();
+
     /** @brief timeout event 
      *
      *  event type returned by wait_for_event(Time timeout) when the
@@ -153,16 +202,21 @@ private:
 
 #if TPROCESS_IMPL==1
     ucontext_t running_ctx;
+#elif TPROCESS_IMPL==3
+    tcontext_t running_ctx;
 #else
     jmp_buf running_ctx; 
 #endif
     char * mystack;
     unsigned long mystack_size;
+    bool mystack_guard;
 
     const Event * ev;
 
 #if TPROCESS_IMPL==1
     static void starter();
+#elif TPROCESS_IMPL==3
+    static void starter(void *);
 #else
     static void starter(int);
 #endif
@@ -14,7 +14,7 @@ class SimplePerson : public cProcess
 public:
   state_t state;
   int id;
-  SimplePerson(const int i = 0) : id(i) {};
+  SimplePerson(const int i = 0) : state(Healthy), id(i) {};
   void init();
   virtual void handleMessage(const cMessage* msg);
 };
@@ -80,18 +80,18 @@ RcppExport SEXP vofv() {
 }
 
 
+Process * simplePerson(SimplePerson * person, int i) {
+  *person = SimplePerson(i);
+  return person;
+}
+
 RcppExport SEXP callSimplePerson(SEXP parms) {
   SimplePerson person;
   Rcpp::RNGScope scope;
   Rcpp::List parmsl(parms);
   int n = Rcpp::as<int>(parmsl["n"]);
   report.clear();
-  for (int i = 0; i < n; i++) {
-    person = SimplePerson(i);
-    Sim::create_process(&person);
-    Sim::run_simulation();
-    Sim::clear();
-  }
+  Sim::run_population(boost::bind(simplePerson, &person, _1), n);
   return Rcpp::wrap(report);
 } 
  
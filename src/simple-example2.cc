@@ -14,7 +14,7 @@ class SimplePerson : public cProcess
 public:
   state_t state;
   int id;
-  SimplePerson(const int i = 0) : id(i) {};
+  SimplePerson(const int i = 0) : state(Healthy), id(i) {};
   void init();
   virtual void handleMessage(const cMessage* msg);
   static EventReport<short,short,double> report;
@@ -59,6 +59,11 @@ void SimplePerson::handleMessage(const cMessage* msg) {
 
 } // handleMessage()
 
+Process * simplePerson(SimplePerson * person, int i) {
+  *person = SimplePerson(i);
+  return person;
+}
+
 RcppExport SEXP callSimplePerson2(SEXP parms) {
   SimplePerson person;
   Rcpp::RNGScope scope;
@@ -73,12 +78,7 @@ RcppExport SEXP callSimplePerson2(SEXP parms) {
   ages.push_back(1.0e+6);
   SimplePerson::report.setPartition(ages);
 
-  for (int i = 0; i < n; i++) {
-    person = SimplePerson(i);
-    Sim::create_process(&person);
-    Sim::run_simulation();
-    Sim::clear();
-  }
+  Sim::run_population(boost::bind(simplePerson, &person, _1), n);
   return SimplePerson::report.wrap();
 } 
 
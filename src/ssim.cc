@@ -23,150 +23,1345 @@
 //  along with SSim.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
 
 #include <siena/ssim.h>
 #include "heap.h"
+#include <boost/bind/bind.hpp>
 #include <R.h>
 
 namespace ssim {
 
 const char * Version = VERSION;
 
-// these are the "private" static variables and types of the Sim class
-//
-static Time			stop_time = INIT_TIME;
-static Time			current_time = INIT_TIME;
-
-static ProcessId		current_process = NULL_PROCESSID;
-
-static bool			running = false;
-
-static SimErrorHandler *	error_handler = 0;
-
 enum ActionType { 
     A_Event, 
     A_Init, 
-    A_Stop 
+    A_Stop,
+    A_Arrival			// next individual of run_concurrent()
 };
     
-struct Action {
-    Time time;
+//
+// the payload of a scheduled action lives in a slot of the slot
+// table, and the event list only holds (key, slot) pairs.  A slot is
+// recycled once its action is popped, and its generation is bumped,
+// so that an EventHandle can tell a pending action from a recycled
+// slot.  Cancelled actions are only marked dead (lazy tombstones):
+// they are skipped when popped, or compacted away when they become
+// the majority of the event list.  Tagged actions also record their
+// position in the kind and symbol indexes of their process.
+//
+struct ActionSlot {
     ActionType type;
     ProcessId pid;
     const Event * event;
+    unsigned generation;
+    bool dead;
+    int kind;
+    int symbol;
+    unsigned kind_pos;
+    unsigned symbol_pos;
+    int timer;			// see Sim::self_signal_timer(), or -1
+
+    ActionSlot() throw()
+	: type(A_Event), pid(NULL_PROCESSID), event(0), generation(0), 
+	  dead(false), kind(-1), symbol(-1), kind_pos(0), symbol_pos(0),
+	  timer(-1) {}
+};
+
+//
+// the observation times of a process (see Sim::observe()), and the
+// entries of the heap of the next observation of each observer
+//
+struct Observer {
+    ProcessId pid;
+    std::vector<Time> times;
+    std::vector<Time>::size_type next;
+    ObservationHook hook;
+    bool active;
+};
+
+struct Observation {
+    Time time;
+    int observer;
+};
+
+// heap order for Observation: the earliest first, then by observer
+struct LaterObservation {
+    bool operator()(const Observation & a, const Observation & b) const {
+	return a.time > b.time || (a.time == b.time && a.observer > b.observer);
+    }
+};
+
+//
+// a recurring timer.  Its action keeps the same slot, and therefore
+// the same handle, from one firing to the next
+//
+struct Timer {
+    Time period;
+    Time stop;
+    int priority;
+};
+
+//
+// actions are ordered by a packed key of two words.  The first word
+// holds the bits of the time, mapped so that they compare as unsigned
+// integers in the same order as the times.  The second word holds the
+// schedule priority (lower values first) in its top 16 bits, and a
+// per-context sequence number in the other 48 bits, so simultaneous
+// actions with the same priority are executed in the order in which
+// they were scheduled.  The order is therefore total, and it is the
+// same for every event list backend.
+//
+typedef unsigned long long ActionKey;
+
+static const ActionKey SIGN_BIT = 1ULL << 63;
+static const ActionKey SEQUENCE_MASK = (1ULL << 48) - 1;
+
+static inline ActionKey time_key(Time t) throw() {
+    if (t == 0.0) 
+	t = 0.0;			// -0.0 and 0.0 are the same time
+    ActionKey b;
+    std::memcpy(&b, &t, sizeof(b));
+    return (b & SIGN_BIT) ? ~b : (b | SIGN_BIT);
+}
 
-    Action(Time t, ActionType at, ProcessId p, const Event * e = 0) throw()
-	: time(t), type(at), pid(p), event(e) {};
+static inline Time key_time(ActionKey k) throw() {
+    ActionKey b = (k & SIGN_BIT) ? (k & ~SIGN_BIT) : ~k;
+    Time t;
+    std::memcpy(&t, &b, sizeof(t));
+    return t;
+}
+
+static inline ActionKey order_key(int priority, ActionKey sequence) throw() {
+    return (ActionKey(priority + 32768) << 48) | (sequence & SEQUENCE_MASK);
+}
+
+struct Action {
+    ActionKey time_key;
+    ActionKey order;
+    unsigned slot;
+
+    Action(ActionKey t, ActionKey o, unsigned s) throw() 
+	: time_key(t), order(o), slot(s) {};
+
+    Time time() const throw() { return key_time(time_key); }
 
     bool operator < (const Action & a) const throw() {
-	return time < a.time;
+	return time_key < a.time_key 
+	    || (time_key == a.time_key && order < a.order);
     }
 };
 
-typedef heap<Action>	a_table_t;
+//
+// kernel statistics (Sim::stats()) are collected unless the package
+// is built with PKG_CXXFLAGS=-DSSIM_STATS=0
+//
+#ifndef SSIM_STATS
+#define SSIM_STATS		1
+#endif
+
+#if SSIM_STATS
+#define SSIM_COUNT(expr)	(expr)
+#else
+#define SSIM_COUNT(expr)
+#endif
+
+//
+// the event list backend is selected at build time, for example with
+// PKG_CXXFLAGS=-DSSIM_EVENT_LIST=SSIM_DARY_HEAP.  All backends pop
+// actions in the same order, since keys are unique.
+//
+// The default is the radix heap.  Actions are scheduled at the clock
+// plus a delay, and the clock never goes back, so their time keys are
+// monotone as the radix heap requires.  An action scheduled in the
+// past (with a negative delay) goes to the overflow heap of the radix
+// heap, so it is still executed in order, only not in O(1); these are
+// counted in KernelStats::out_of_order.
+//
+#define SSIM_BINARY_HEAP	1
+#define SSIM_DARY_HEAP		2
+#define SSIM_PAIRING_HEAP	3
+#define SSIM_RADIX_HEAP		4
+
+#ifndef SSIM_EVENT_LIST
+#define SSIM_EVENT_LIST		SSIM_RADIX_HEAP
+#endif
+
+struct ActionTimeKey {
+    ActionKey operator()(const Action & a) const throw() { return a.time_key; }
+};
+
+#if SSIM_EVENT_LIST == SSIM_BINARY_HEAP
+typedef heap<Action>		a_table_t;
+#elif SSIM_EVENT_LIST == SSIM_DARY_HEAP
+typedef dary_heap<Action,4>	a_table_t;
+#elif SSIM_EVENT_LIST == SSIM_PAIRING_HEAP
+typedef pairing_heap<Action>	a_table_t;
+#elif SSIM_EVENT_LIST == SSIM_RADIX_HEAP
+typedef radix_heap<Action,ActionTimeKey> a_table_t;
+#else
+#error Unknown SSIM_EVENT_LIST backend
+#endif
+
+//
+// the schedule of actions.  Actions scheduled at the current time
+// (zero delay) with the default priority do not go through the event
+// list: they are appended to a FIFO lane, so the most common kind of
+// action costs O(1) to schedule and to pop.  The lane is merged with
+// the event list by comparing the full keys of their first actions,
+// so the keys in the lane must be increasing.  Their sequence numbers
+// increase, and their times are taken from the clock, which usually
+// only moves forward.  But Sim::advance_delay() moves the clock ahead
+// without popping anything, and the next action popped takes it back,
+// so an action at the current time goes to the event list instead
+// when it would come before the last action of the lane.
+//
+// The queue also remembers the time of the last action popped from
+// the event list: an action scheduled before it (with a negative
+// delay) is late, which the radix heap only handles in its overflow
+// heap.  first() does not change it.
+//
+class ActionQueue {
+public:
+    typedef a_table_t::size_type size_type;
+
+    ActionQueue() throw() : head(0), last(0) {}
+
+    bool empty() throw() { return head == lane.size() && list.empty(); }
+    size_type size() const throw() { 
+	return list.size() + (lane.size() - head); 
+    }
+    // actions in no particular order
+    const Action & operator[](size_type i) const throw() { 
+	return (i < list.size()) ? list[i] : lane[head + i - list.size()];
+    }
+
+    bool late(const Action & a) const throw() { return a.time_key < last; }
+
+    void insert(const Action & a) throw() { list.insert(a); }
+    void insert_now(const Action & a) throw() {
+	if (head == lane.size() || lane.back() < a)
+	    lane.push_back(a);
+	else
+	    list.insert(a);
+    }
+    template <typename Iterator>
+    void insert_bulk(Iterator i, Iterator end) { list.insert_bulk(i, end); }
+
+    const Action & first() throw() {
+	if (head < lane.size() && (list.empty() || !(list.first() < lane[head])))
+	    return lane[head];
+	return list.first();
+    }
+
+    Action pop_first() throw() {
+	if (head < lane.size() && (list.empty() || !(list.first() < lane[head]))) {
+	    Action a = lane[head++];
+	    if (head == lane.size()) {
+		lane.clear();
+		head = 0;
+	    }
+	    return a;
+	}
+	Action a = list.pop_first();
+	if (last < a.time_key)
+	    last = a.time_key;
+	return a;
+    }
+
+    void clear() throw() {
+	list.clear();
+	lane.clear();
+	head = 0;
+	last = 0;
+    }
+
+    template <typename Predicate>
+    void remove_if(Predicate pred) {
+	list.remove_if(pred);
+	lane.erase(std::remove_if(lane.begin() + head, lane.end(), pred), 
+		   lane.end());
+    }
+
+private:
+    a_table_t			list;
+    std::vector<Action>		lane;
+    std::vector<Action>::size_type head;
+    ActionKey			last;	// of the last action popped from list
+};
 
-static a_table_t actions;
+typedef std::vector<std::vector<unsigned> > SlotIndex;
 
 struct PDescr {
     Process * 	process;
-    bool terminated;
     Time available_at;
+    SlotIndex kinds;		// slots of the pending actions, by kind
+    SlotIndex symbols;		// slots of the pending actions, by symbol
+    std::vector<int> observers;	// see Sim::observe(), dropped at A_Stop
+    unsigned pending;		// number of pending actions
+    int index;			// individual of run_concurrent(), or -1
+    bool terminated;
+    bool batch;			// see Sim::batch_events()
 
     PDescr(Process * p) 
-	: process(p), terminated(false), available_at(INIT_TIME) {}
+	: process(p), available_at(INIT_TIME), pending(0), index(-1), 
+	  terminated(false), batch(false) {}
+
+    // re-initialises a recycled descriptor, keeping the capacity of
+    // its (empty) indexes
+    void reset(Process * p) throw() {
+	process = p;
+	available_at = INIT_TIME;
+	pending = 0;
+	index = -1;
+	terminated = false;
+	batch = false;
+	observers.clear();
+    }
 };
 
 typedef std::vector<PDescr> PsTable;
-static PsTable processes;
 
-  void Rprint_actions() {
-    Rprintf("\n[");
-    for (a_table_t::iterator it = actions.begin(); it != actions.end(); it++)
-      Rprintf("(time=%f,%s), ",it->time, it->type, it->event->str().c_str());
-    Rprintf("]\n");
-  }
+//
+// the event arena of a context.  Blocks are carved out of large chunks
+// and recycled through free lists, one per size class (multiples of
+// 16 bytes, up to 256 bytes).  Larger blocks go straight to malloc.
+// Every block starts with a header that records its arena and size
+// class, so a block always goes back to the arena that allocated it.
+// When no block is live, the arena can be reset wholesale: the free
+// lists are dropped and the chunks are carved again from the start.
+//
+// An arena is retired, rather than deleted, with its context.  Blocks
+// that are still live then belong to events referenced elsewhere
+// (e.g., by the schedule of another context), and they may come back
+// later, from any thread.  A retired arena counts them down, and the
+// last one deletes the arena and its chunks.
+//
+class EventArena {
+public:
+    EventArena() throw() : chunk(0), next(0), end(0), remote(0), orphans(0) {
+	for (unsigned c = 0; c < Classes; ++c) free_lists[c] = 0;
+	stats_.allocations = stats_.releases = stats_.system_allocations
+	    = stats_.resets = stats_.live = stats_.reserved = 0;
+    }
 
+    // called by the context that owns the arena, instead of delete
+    void retire() throw() {
+	drain();
+	if (stats_.live == 0) {
+	    delete this;
+	    return;
+	}
+	//
+	// from now on, released blocks go to release_orphan().  The
+	// blocks released just before are still counted as live.
+	//
+	orphans.store(stats_.live, std::memory_order_relaxed);
+	Header * h = remote.exchange(retired(), std::memory_order_acq_rel);
+	while (h != 0) {
+	    Header * next = h->next;
+	    release_orphan(h);
+	    h = next;
+	}
+    }
 
+    void * allocate(std::size_t size) {
+	unsigned c = (size + Granularity - 1) / Granularity;
+	Header * h;
+	if (c >= Classes) {
+	    h = static_cast<Header *>(std::malloc(size + sizeof(Header)));
+	    if (h == 0) throw std::bad_alloc();
+	    ++stats_.system_allocations;
+	} else if (free_lists[c] != 0 || (drain(), free_lists[c] != 0)) {
+	    h = free_lists[c];
+	    free_lists[c] = h->next;
+	} else {
+	    std::size_t bytes = sizeof(Header) + c*Granularity;
+	    if (next + bytes > end) 
+		next_chunk();
+	    h = reinterpret_cast<Header *>(next);
+	    next += bytes;
+	}
+	h->owner.arena = this;
+	h->owner.size_class = c;
+	++stats_.allocations;
+	++stats_.live;
+	return h + 1;
+    }
 
-class SimImpl {
+    // local is the arena of the calling thread.  Blocks of other
+    // arenas are handed back to their owner through its remote list,
+    // which is the only part of an arena shared between threads.
+    static void deallocate(void * p, EventArena & local) throw() {
+	if (p == 0) return;
+	Header * h = static_cast<Header *>(p) - 1;
+	EventArena * a = h->owner.arena;
+	if (a != &local) {
+	    Header * head = a->remote.load(std::memory_order_acquire);
+	    do {
+		if (head == retired()) {
+		    a->release_orphan(h);
+		    return;
+		}
+		h->next = head;
+	    } while (!a->remote.compare_exchange_weak(head, h,
+						      std::memory_order_acq_rel,
+						      std::memory_order_acquire));
+	    return;
+	}
+	a->release(h);
+    }
+
+    void reset() throw() {
+	drain();
+	if (stats_.live != 0 || chunks.empty()) return;
+	for (unsigned c = 0; c < Classes; ++c) free_lists[c] = 0;
+	chunk = 0;
+	next = chunks[0];
+	end = next + ChunkSize;
+	++stats_.resets;
+    }
+
+    const ArenaStats & stats() const throw() { return stats_; }
+
+    void reset_stats() throw() {
+	stats_.allocations = stats_.releases = stats_.system_allocations 
+	    = stats_.resets = 0;
+    }
+
+private:
+    static const std::size_t Granularity = 16;
+    static const unsigned Classes = 17;	// class 0 is unused
+    static const std::size_t ChunkSize = 64*1024;
+
+    // the header keeps blocks aligned to 16 bytes
+    union Header {
+	struct {
+	    EventArena * arena;
+	    unsigned size_class;
+	} owner;
+	Header * next;			// in a free list
+	char align[16];
+    };
+
+    ~EventArena() {
+	for (std::vector<char *>::size_type i = 0; i < chunks.size(); ++i)
+	    std::free(chunks[i]);
+    }
+
+    // marks the remote list of a retired arena
+    static Header * retired() throw() {
+	return reinterpret_cast<Header *>(1);
+    }
+
+    // a block of a retired arena comes back, from any thread
+    void release_orphan(Header * h) throw() {
+	if (h->owner.size_class >= Classes)
+	    std::free(h);
+	if (orphans.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	    delete this;
+    }
+
+    // takes back the blocks released by other threads
+    void drain() throw() {
+	Header * h = remote.exchange(0, std::memory_order_acquire);
+	while (h != 0) {
+	    Header * next = h->next;
+	    release(h);
+	    h = next;
+	}
+    }
+
+    // the size class survives in a free list, where next only
+    // overwrites the owner
+    void release(Header * h) throw() {
+	++stats_.releases;
+	--stats_.live;
+	unsigned c = h->owner.size_class;
+	if (c >= Classes) {
+	    std::free(h);
+	} else {
+	    h->next = free_lists[c];
+	    free_lists[c] = h;
+	}
+    }
+
+    void next_chunk() {
+	if (chunk + 1 < chunks.size()) {
+	    next = chunks[++chunk];
+	} else {
+	    char * c = static_cast<char *>(std::malloc(ChunkSize));
+	    if (c == 0) throw std::bad_alloc();
+	    ++stats_.system_allocations;
+	    stats_.reserved += ChunkSize;
+	    chunks.push_back(c);
+	    chunk = chunks.size() - 1;
+	    next = c;
+	}
+	end = next + ChunkSize;
+    }
+
+    std::vector<char *> chunks;
+    std::vector<char *>::size_type chunk;	// chunk being carved
+    char * next;
+    char * end;
+    Header * free_lists[Classes];
+    ArenaStats stats_;
+    std::atomic<Header *> remote;	// released by other threads
+    std::atomic<unsigned long> orphans;	// live blocks, once retired
+};
+
+//
+// the event trace of a context: a ring buffer of the last executed
+// actions.  Recording costs a test when the trace is disabled (zero
+// capacity), and a few stores otherwise.  The dump is a binary file:
+// an 8-byte magic string, the number of records n (32-bit integer),
+// and then the records column by column, oldest first: n 32-bit
+// person ids, n doubles for the times, n 32-bit kinds, n 32-bit
+// process ids and n 32-bit queue sizes, all in native byte order.
+//
+class EventTrace {
 public:
-    static void schedule(Time t, ActionType i, ProcessId p, 
-			 const Event * e = 0) throw() {
-	if (e != 0) { 
-	    ++(e->refcount); 
+    EventTrace() throw() : person(0), flags(0), next(0), count(0) {}
+
+    bool enabled() const throw() { return !records.empty(); }
+
+    void configure(std::size_t capacity, const std::string & f, int fl) {
+	records.assign(capacity, Record());
+	next = count = 0;
+	file = f;
+	flags = fl;
+    }
+
+    void record(Time t, ProcessId pid, int kind, std::size_t queue) throw() {
+	Record & r = records[next];
+	r.time = t;
+	r.person = person;
+	r.pid = pid;
+	r.kind = kind;
+	r.queue = queue;
+	if (++next == records.size()) 
+	    next = 0;
+	if (count < records.size()) 
+	    ++count;
+    }
+
+    // dumps to the configured file if the given flag is set
+    void dump_on(int flag) const throw() {
+	if ((flags & flag) && enabled() && !file.empty())
+	    dump(file);
+    }
+
+    bool dump(const std::string & f) const throw() {
+	FILE * out = std::fopen(f.c_str(), "wb");
+	if (out == 0) 
+	    return false;
+	std::size_t first = (count < records.size()) ? 0 : next;
+	int32_t n = count;
+	bool ok = std::fwrite("SSIMTRC1", 1, 8, out) == 8
+	    && std::fwrite(&n, sizeof(n), 1, out) == 1;
+	for (int column = 0; ok && column < 5; ++column) {
+	    for (std::size_t i = 0; ok && i < count; ++i) {
+		const Record & r = records[(first + i) % records.size()];
+		switch (column) {
+		case 0: ok = write32(out, r.person); break;
+		case 1: ok = std::fwrite(&r.time, sizeof(r.time), 1, out) == 1; break;
+		case 2: ok = write32(out, r.kind); break;
+		case 3: ok = write32(out, r.pid); break;
+		case 4: ok = write32(out, r.queue); break;
+		}
+	    }
 	}
-	actions.insert(Action(current_time + t, i, p, e ));
+	return (std::fclose(out) == 0) && ok;
+    }
+
+    int person;				// id of the current individual
+    std::string file;
+    int flags;
+
+private:
+    struct Record {
+	Time time;
+	int32_t person;
+	int32_t pid;
+	int32_t kind;
+	int32_t queue;
+    };
+
+    static bool write32(FILE * out, int32_t x) throw() {
+	return std::fwrite(&x, sizeof(x), 1, out) == 1;
+    }
+
+    std::vector<Record> records;
+    std::size_t next;
+    std::size_t count;
+};
+
+class ParallelImpl;
+
+//
+// an event for a process of another partition of a parallel
+// simulation, held in the outbox of the sending partition until the
+// end of the current window
+//
+struct Mail {
+    Time time;
+    Time sent;			// clock of the sender
+    ProcessId pid;		// local to the receiving partition
+    const Event * event;
+    EventTag tag;
+
+    // messages sent earlier are scheduled first
+    bool operator < (const Mail & m) const throw() { return sent < m.sent; }
+};
+
+//
+// this is the state of one simulation.  These used to be the
+// "private" static variables of the Sim class; they are now owned by
+// a SimContext, so that independent simulations can run in different
+// threads of the same program.
+//
+class SimImpl {
+public:
+    Time			stop_time;
+    Time			current_time;
+    ProcessId			current_process;
+    bool			running;
+    bool			lock;
+    SimErrorHandler *		error_handler;
+    ActionQueue			actions;
+    PsTable			processes;
+    EventArena &		arena;		// retired, not deleted
+    KernelStats			stats;
+    EventTrace			trace;
+
+    SimImpl() throw()
+	: stop_time(INIT_TIME), current_time(INIT_TIME), 
+	  current_process(NULL_PROCESSID), running(false), lock(false),
+	  error_handler(0), arena(*new EventArena()),
+	  dead(0), sequence(0), generation_floor(0), reuse_pids(false),
+	  arrivals(0), population(0), 
+	  until(std::numeric_limits<Time>::infinity()), n_observers(0), 
+	  parallel(0), 
+	  partition(0), partitions(1) {}
+
+    ~SimImpl() { 
+	error_handler = 0;	// may already be gone at this point
+	clear(); 
+	arena.retire();
     }
-    static void schedule_now(ActionType i, ProcessId p, 
+
+    std::vector<ActionSlot>	slots;
+    std::vector<unsigned>	free_slots;
+    std::vector<Timer>		timers;
+    std::vector<int>		free_timers;
+    ActionQueue::size_type	dead;		// tombstones in actions
+    ActionKey			sequence;	// of the next action
+    unsigned			generation_floor; // see run_branch()
+
+    // population-concurrent mode: process ids are recycled once a
+    // process has stopped and has no pending actions
+    bool			reuse_pids;
+    std::vector<ProcessId>	free_pids;
+    ProcessFactory		arrival_factory;
+    PopulationEntry		arrival_time;
+    PopulationHook		departure;
+    int				arrivals;	// individuals created so far
+    int				population;
+
+    // actions after this time stay scheduled (see run_until())
+    Time			until;
+
+    // the events of the current batch (see Sim::batch_events())
+    std::vector<const Event *>	batch;
+
+    // the actions of Sim::self_signal_events()
+    std::vector<Action>		bulk;
+
+    // observers (see Sim::observe()).  A deque, so that a hook can
+    // register observers while it runs.  Observers are recycled after
+    // clear(), keeping the capacity of their times.
+    std::deque<Observer>	observers;
+    int				n_observers;
+    std::vector<Observation>	observations;	// heap, LaterObservation
+
+    int add_observer(const std::vector<Time> & times, 
+		     const ObservationHook & hook);
+    void drop_observers(ProcessId p) throw();
+    void observe(Time limit);
+
+    // parallel execution (see ParallelSim): the partition of this
+    // context.  Global process
+    // ids interleave the partitions, so that the local id of a
+    // process is its global id divided by the number of partitions.
+    ParallelImpl *		parallel;
+    int				partition;
+    int				partitions;
+
+    ProcessId global(ProcessId p) const throw() {
+	return (parallel == 0 || p < 0) ? p : p*partitions + partition;
+    }
+
+    // the local id of a global process id, or NULL_PROCESSID for a
+    // process of another partition
+    ProcessId local(ProcessId p) const throw() {
+	if (parallel == 0) 
+	    return p;
+	return (p >= 0 && p % partitions == partition) 
+	    ? p / partitions : NULL_PROCESSID;
+    }
+
+    EventHandle signal(ProcessId p, Time t, const Event * e, 
+		       const EventTag & tag) throw() {
+	if (parallel == 0) 
+	    return schedule_at(t, A_Event, p, e, tag);
+	if (p % partitions == partition) 
+	    return schedule_at(t, A_Event, p / partitions, e, tag);
+	post(p, t, e, tag);
+	return EventHandle();
+    }
+    void post(ProcessId p, Time t, const Event * e, 
+	      const EventTag & tag) throw();
+
+    EventHandle schedule(Time t, ActionType i, ProcessId p, 
+			 const Event * e = 0, 
+			 const EventTag & tag = EventTag()) throw() {
+	return schedule_at(current_time + t, i, p, e, tag);
+    }
+    EventHandle schedule_now(ActionType i, ProcessId p, 
 			     const Event * e = 0) throw() {
+	return schedule_at(current_time, i, p, e, EventTag());
+    }
+    EventHandle schedule_at(Time t, ActionType i, ProcessId p, 
+			    const Event * e, const EventTag & tag) throw() {
+	unsigned k = new_slot(i, p, e, tag);
+	Action a(time_key(t), order_key(tag.priority, sequence++), k);
+	if (t == current_time && tag.priority == 0)
+	    actions.insert_now(a);
+	else {
+	    SSIM_COUNT(stats.out_of_order += actions.late(a));
+	    actions.insert(a);
+	}
+	SSIM_COUNT(++stats.inserts);
+	SSIM_COUNT(stats.max_queue = std::max(stats.max_queue, 
+					      actions.size()));
+	return EventHandle(k, slots[k].generation);
+    }
+
+    EventHandle schedule_timer(Time t, ProcessId p, const Event * e, 
+			       const EventTag & tag, Time period, 
+			       Time stop) throw() {
+	EventHandle h = schedule_at(t, A_Event, p, e, tag);
+	if (period > 0.0) {
+	    int i;
+	    if (free_timers.empty()) {
+		i = timers.size();
+		timers.push_back(Timer());
+	    } else {
+		i = free_timers.back();
+		free_timers.pop_back();
+	    }
+	    timers[i].period = period;
+	    timers[i].stop = stop;
+	    timers[i].priority = tag.priority;
+	    slots[h.slot].timer = i;
+	}
+	return h;
+    }
+
+    // schedules the next firing of the timer of slot k, which fired at
+    // time t, in the same slot.  Returns false if the timer is over.
+    bool rearm(unsigned k, Time t) throw() {
+	ActionSlot & as = slots[k];
+	const Timer & tm = timers[as.timer];
+	Time next = t + tm.period;
+	if (!(next > t) || next > tm.stop || processes[as.pid].terminated)
+	    return false;
+	if (as.event != 0)
+	    ++(as.event->refcount);	// one for the delivery, one for the slot
+	++processes[as.pid].pending;
+	actions.insert(Action(time_key(next), 
+			      order_key(tm.priority, sequence++), k));
+	SSIM_COUNT(++stats.inserts);
+	return true;
+    }
+
+    void schedule_bulk(const Event * const * events, const Time * delays,
+		       const EventTag * tags, unsigned n, 
+		       EventHandle * handles) throw();
+
+    // takes a free slot for a new action, and links it to the
+    // indexes of its process
+    unsigned new_slot(ActionType i, ProcessId p, const Event * e, 
+		      const EventTag & tag) throw() {
 	if (e != 0) { 
 	    ++(e->refcount); 
 	}
-	actions.insert(Action(current_time, i, p, e ));
+	unsigned k;
+	if (free_slots.empty()) {
+	    k = slots.size();
+	    slots.push_back(ActionSlot());
+	    slots[k].generation = generation_floor;
+	} else {
+	    k = free_slots.back();
+	    free_slots.pop_back();
+	}
+	ActionSlot & as = slots[k];
+	as.type = i;
+	as.pid = p;
+	as.event = e;
+	as.dead = false;
+	as.kind = tag.kind;
+	as.symbol = tag.symbol;
+	if (p >= 0) 
+	    ++processes[p].pending;
+	if (tag.kind >= 0) 
+	    as.kind_pos = link(processes[p].kinds, tag.kind, k);
+	if (tag.symbol >= 0) 
+	    as.symbol_pos = link(processes[p].symbols, tag.symbol, k);
+	return k;
+    }
+
+    static unsigned link(SlotIndex & index, int key, unsigned k) {
+	if (index.size() <= unsigned(key))
+	    index.resize(key + 1);
+	index[key].push_back(k);
+	return index[key].size() - 1;
     }
+
+    // removes a slot from the indexes of its process, moving the
+    // last slot of each index into its position
+    void unlink(unsigned k) throw() {
+	ActionSlot & as = slots[k];
+	if (as.kind >= 0) {
+	    std::vector<unsigned> & v = processes[as.pid].kinds[as.kind];
+	    unsigned last = v.back();
+	    v[as.kind_pos] = last;
+	    slots[last].kind_pos = as.kind_pos;
+	    v.pop_back();
+	    as.kind = -1;
+	}
+	if (as.symbol >= 0) {
+	    std::vector<unsigned> & v = processes[as.pid].symbols[as.symbol];
+	    unsigned last = v.back();
+	    v[as.symbol_pos] = last;
+	    slots[last].symbol_pos = as.symbol_pos;
+	    v.pop_back();
+	    as.symbol = -1;
+	}
+    }
+
+    unsigned remove_all(SlotIndex & index, int key) throw() {
+	if (key < 0 || unsigned(key) >= index.size())
+	    return 0;
+	std::vector<unsigned> & v = index[key];
+	unsigned n = v.size();
+	while (!v.empty())
+	    kill(v.back());	// kill() unlinks the slot
+	compact();
+	SSIM_COUNT(stats.removed += n);
+	return n;
+    }
+
+    static unsigned count(const SlotIndex & index, int key) throw() {
+	if (key < 0 || unsigned(key) >= index.size())
+	    return 0;
+	return index[key].size();
+    }
+
+    void free_slot(unsigned k) throw() {
+	ActionSlot & as = slots[k];
+	as.event = 0;
+	as.dead = false;
+	if (as.timer >= 0) {
+	    free_timers.push_back(as.timer);
+	    as.timer = -1;
+	}
+	new_generation(as);
+	free_slots.push_back(k);
+    }
+
+    // invalidates the handles of a slot
+    void new_generation(ActionSlot & as) throw() {
+	if (++as.generation < generation_floor)
+	    as.generation = generation_floor;
+    }
+
+    bool pending(const EventHandle & h) const throw() {
+	return h.slot < slots.size() 
+	    && slots[h.slot].generation == h.generation 
+	    && !slots[h.slot].dead;
+    }
+
+    // marks a scheduled action as cancelled.  Its slot stays
+    // allocated until the action leaves the event list.
+    void kill(unsigned k) throw() {
+	unlink(k);
+	ActionSlot & as = slots[k];
+	as.dead = true;
+	release(as.event);
+	as.event = 0;
+	++dead;
+	settle(as.pid);
+    }
+
+    // accounts for an action of process p leaving the schedule, and
+    // recycles the process id of a stopped process once the last of
+    // its actions has gone
+    void settle(ProcessId p) throw() {
+	if (p < 0) 
+	    return;
+	PDescr & pd = processes[p];
+	if (--pd.pending == 0 && pd.terminated && reuse_pids) {
+	    pd.process = 0;
+	    free_pids.push_back(p);
+	}
+    }
+
+    ProcessId create_process(Process * p) throw() {
+	ProcessId pid;
+	if (free_pids.empty()) {
+	    pid = processes.size();
+	    processes.push_back(PDescr(p));
+	} else {
+	    pid = free_pids.back();
+	    free_pids.pop_back();
+	    processes[pid].reset(p);
+	}
+	schedule_now(A_Init, pid);
+	return pid;
+    }
+
+    void arrive();
+    void deliver_batch(PDescr & pd, const Event * e, ActionKey key);
+    void run_branch(const boost::function<void()> & setup);
+
+    // drops the cancelled actions once they are the majority of the
+    // event list, so that cancelling costs amortized constant time
+    void compact() throw() {
+	if (dead > 64 && 2*dead > actions.size())
+	    compact_now();
+    }
+    void compact_now() throw();
+    bool resumable() throw();
+
+    bool cancel(const EventHandle & h) throw() {
+	if (!pending(h)) 
+	    return false;
+	kill(h.slot);
+	compact();
+	SSIM_COUNT(++stats.cancelled);
+	return true;
+    }
+
+    // drops a reference to an event, deleting it when it is no
+    // longer scheduled anywhere
+    static void release(const Event * e) throw() {
+	if (e != 0 && --(e->refcount) == 0) 
+	    delete(e);
+    }
+
+    void clear() throw();
+    void clear_actions() throw();
+    bool run(Time t = std::numeric_limits<Time>::infinity());
+    void loop();
+    void failed() throw();
+    void run_population(const ProcessFactory & factory, int n, 
+			const PopulationHook & hook);
+    void create_population(const ProcessFactory & factory, int n, 
+			   const PopulationEntry & entry,
+			   const PopulationHook & departure);
+    void run_concurrent(const ProcessFactory & factory, int n, 
+			const PopulationEntry & entry,
+			const PopulationHook & departure);
+
+    static inline SimImpl & current() throw();
 };
 
+//
+// the context bound to each thread.  A thread that never binds a
+// context lazily gets a default context of its own.
+//
+static thread_local SimContext * current_context = 0;
+
+static SimContext * default_context() throw() {
+    static thread_local SimContext ctx;
+    return &ctx;
+}
+
+inline SimImpl & SimImpl::current() throw() {
+    SimContext * c = current_context;
+    if (c == 0) 
+	current_context = c = default_context();
+    return *(c->impl);
+}
+
+static inline SimImpl & sim() throw() {
+    return SimImpl::current();
+}
+
+SimContext::SimContext() : impl(new SimImpl()) {}
+
+SimContext::~SimContext() {
+    if (current_context == this)
+	current_context = 0;
+    delete impl;
+}
+
+SimContext * SimContext::current() throw() {
+    if (current_context == 0) 
+	current_context = default_context();
+    return current_context;
+}
+
+SimContext * SimContext::set_current(SimContext * c) throw() {
+    SimContext * previous = current_context;
+    current_context = c;
+    return previous;
+}
+
+  void Rprint_actions() {
+    ActionQueue & actions = sim().actions;
+    Rprintf("\n[");
+    std::vector<ActionSlot> & slots = sim().slots;
+    for (ActionQueue::size_type i = 0; i < actions.size(); ++i) {
+      const ActionSlot & as = slots[actions[i].slot];
+      if (!as.dead)
+	Rprintf("(time=%f,%s), ",actions[i].time(), as.event ? as.event->str().c_str() : "(null)");
+    }
+    Rprintf("]\n");
+  }
+
 ProcessId Sim::create_process(Process * p) throw() {
-    processes.push_back(PDescr(p));
-    ProcessId newpid = processes.size() - 1;
-    SimImpl::schedule_now(A_Init, newpid);
-    return newpid;
+    SimImpl & s = sim();
+    return s.global(s.create_process(p));
 }
 
-void Sim::clear() throw() {
+void SimImpl::clear() throw() {
     running = false;
     current_time = INIT_TIME;
     current_process = NULL_PROCESSID;
     processes.clear();
+    free_pids.clear();
+    reuse_pids = false;
+    arrival_factory = ProcessFactory();
+    arrival_time = PopulationEntry();
+    departure = PopulationHook();
+    population = arrivals = 0;
     if (error_handler) error_handler->clear();
-    for(a_table_t::iterator a = actions.begin(); a != actions.end(); ++a) {
-	const Event * e = (*a).event;
-	if (e != 0 && --(e->refcount) == 0) 
-	    delete(e);
+    clear_actions();
+}
+
+void SimImpl::clear_actions() throw() {
+    //
+    // handles may outlive the simulation, so slots are recycled
+    // rather than dropped, with a new generation
+    //
+    for(ActionQueue::size_type i = 0; i < actions.size(); ++i) {
+	ActionSlot & as = slots[actions[i].slot];
+	release(as.event);
+	as.event = 0;
+	as.dead = false;
+	as.kind = -1;
+	as.symbol = -1;
+	as.timer = -1;
+	new_generation(as);
     }
     actions.clear();
+    timers.clear();
+    free_timers.clear();
+    observations.clear();
+    n_observers = 0;
+    dead = 0;
+    sequence = 0;
+    free_slots.clear();
+    for(unsigned k = slots.size(); k > 0; --k)
+	free_slots.push_back(k - 1);
+    arena.reset();
 }
 
-typedef a_table_t::iterator ForwardIterator;
+void Sim::clear() throw() {
+    sim().clear();
+}
+
+//
+// runs one simulation per individual in the same context.  The state
+// of the context is reset in place between individuals, so that the
+// event list, the slot table, the arena and the process table keep
+// their capacity, and the process is initialised directly rather
+// than through an A_Init action.
+//
+void SimImpl::run_population(const ProcessFactory & factory, int n,
+			     const PopulationHook & hook) {
+    if (lock)
+	throw std::logic_error("ssim: run_population() called while the simulation is running");
+    clear();
+    for (int i = 0; i < n; ++i) {
+	trace.person = i;
+	Process * p = factory(i);
+	if (processes.empty()) 
+	    processes.push_back(PDescr(p));
+	processes[0].process = p;
+	lock = true;
+	running = true;
+	current_process = 0;
+	try {
+	    p->init();
+	    processes[0].available_at = current_time;
+	    loop();
+	} catch (...) {
+	    failed();
+	    throw;
+	}
+	lock = false;
+	//
+	// same as clear(), except for the slot of the process, whose
+	// indexes keep their capacity
+	//
+	running = false;
+	current_time = INIT_TIME;
+	current_process = NULL_PROCESSID;
+	if (error_handler) error_handler->clear();
+	clear_actions();
+	processes.resize(1, PDescr(0));
+	PDescr & slot = processes[0];
+	slot.reset(0);
+	for (SlotIndex::size_type k = 0; k < slot.kinds.size(); ++k)
+	    slot.kinds[k].clear();
+	for (SlotIndex::size_type k = 0; k < slot.symbols.size(); ++k)
+	    slot.symbols[k].clear();
+	if (hook) 
+	    hook(i);
+    }
+    processes.clear();
+}
+
+void Sim::run_population(ProcessFactory factory, int n, 
+			 PopulationHook hook) {
+    sim().run_population(factory, n, hook);
+}
+
+//
+// runs a whole population on one schedule.  The individuals are
+// created one at a time by a single pending arrival action, so the
+// schedule and the process table only hold the individuals that are
+// alive at the same time.
+//
+void SimImpl::create_population(const ProcessFactory & factory, int n, 
+				const PopulationEntry & entry,
+				const PopulationHook & departure) {
+    reuse_pids = true;
+    arrival_factory = factory;
+    arrival_time = entry;
+    this->departure = departure;
+    arrivals = 0;
+    population = n;
+    if (n > 0)
+	schedule_at(entry ? entry(0) : 0.0, A_Arrival, NULL_PROCESSID, 0, 
+		    EventTag());
+}
+
+void SimImpl::run_concurrent(const ProcessFactory & factory, int n, 
+			     const PopulationEntry & entry,
+			     const PopulationHook & departure) {
+    if (lock)
+	throw std::logic_error("ssim: run_concurrent() called while the simulation is running");
+    clear();
+    create_population(factory, n, entry, departure);
+    run();
+    clear();
+}
+
+void SimImpl::arrive() {
+    int i = arrivals++;
+    ProcessId pid = create_process(arrival_factory(i));
+    processes[pid].index = i;
+    if (arrivals < population) {
+	Time t = arrival_time ? arrival_time(arrivals) : 0.0;
+	schedule_at(std::max(t, current_time), A_Arrival, NULL_PROCESSID, 0, 
+		    EventTag());
+    }
+}
+
+void Sim::run_concurrent(ProcessFactory factory, int n, 
+			 PopulationEntry entry, PopulationHook departure) {
+    sim().run_concurrent(factory, n, entry, departure);
+}
+
+void Sim::create_population(ProcessFactory factory, int n, 
+			    PopulationEntry entry, PopulationHook departure) {
+    sim().create_population(factory, n, entry, departure);
+}
+
+//
+// predicate for ActionQueue::remove_if(): it frees the slots of the
+// cancelled actions it drops
+//
+class DeadAction {
+public:
+    DeadAction(SimImpl & s) : sim(s) {}
+    bool operator()(const Action & a) const {
+	if (!sim.slots[a.slot].dead)
+	    return false;
+	sim.free_slot(a.slot);
+	return true;
+    }
+private:
+    SimImpl & sim;
+};
+
+void SimImpl::compact_now() throw() {
+    actions.remove_if(DeadAction(*this));
+    dead = 0;
+}
+
+bool Sim::cancel_event(EventHandle h) throw() {
+    return sim().cancel(h);
+}
+
+bool Sim::pending(EventHandle h) throw() {
+    return sim().pending(h);
+}
 
 void Sim::remove_event(EventPredicate pred) throw() {
-  ForwardIterator first = actions.begin();
-  ForwardIterator last = actions.end();
-  ForwardIterator result = first;
-  while (first != last) {
-    if ((*first).type != A_Event) {
-      *result = *first;
-      ++result;
-    } else {
-      const Event * e = (*first).event;
-      if (e != 0) { 
-	if(!pred(e)) {
-	  *result = *first;
-	  ++result;
-	} else {
-	  delete(e);
+    SimImpl & s = sim();
+    for(ActionQueue::size_type i = 0; i < s.actions.size(); ++i) {
+	const ActionSlot & as = s.slots[s.actions[i].slot];
+	if (!as.dead && as.type == A_Event && as.event != 0 && pred(as.event)) {
+	    s.kill(s.actions[i].slot);
+	    SSIM_COUNT(++s.stats.removed);
 	}
-      }
     }
-    ++first;
-  }
-  actions.erase(result, actions.end());
+    s.compact();
+}
+
+void * Sim::allocate(std::size_t size) {
+    return sim().arena.allocate(size);
+}
+
+void Sim::deallocate(void * p) throw() {
+    EventArena::deallocate(p, sim().arena);
+}
+
+const ArenaStats & Sim::arena_stats() throw() {
+    return sim().arena.stats();
+}
+
+void Sim::reset_arena_stats() throw() {
+    sim().arena.reset_stats();
+}
+
+const KernelStats & Sim::stats() throw() {
+    return sim().stats;
+}
+
+void Sim::reset_stats() throw() {
+    sim().stats = KernelStats();
+}
+
+const char * Sim::event_list() throw() {
+    return a_table_t::name();
 }
 
 //
 // this is the simulator main loop.
 //
 void Sim::run_simulation() {
+    sim().run();
+}
+
+//
+// returns true if the simulation paused at t, and can carry on
+//
+bool SimImpl::run(Time t) {
     //
     // prevents anyone from re-entering the main loop.  Note that this
     // isn't meant to be thread-safe, it works if some process calls
     // Sim::run_simulation() within their process_event() function.
+    // Different threads run different contexts, each with its own
+    // lock.
     //
-    static bool lock = false;
-    if (lock) return;
+    if (lock) return false;
     lock = true;
     running = true;
+    until = t;
+    try {
+	loop();
+    } catch (...) {
+	until = std::numeric_limits<Time>::infinity();
+	failed();
+	throw;
+    }
+    //
+    // unless the simulation was stopped, the clock reaches the end
+    // of the window, but not beyond the stop time
+    //
+    bool paused = running && resumable();
+    if (running && t != std::numeric_limits<Time>::infinity()) {
+	Time end = t;
+	if (stop_time != INIT_TIME && stop_time < end)
+	    end = stop_time;
+	if (current_time < end)
+	    current_time = end;
+    }
+    until = std::numeric_limits<Time>::infinity();
+    lock = false;
+    running = false;
+    return paused;
+}
+
+//
+// whether a paused simulation has anything left to do up to the stop
+// time: a live action, or an observation of an active observer.
+// Cancelled actions and removed observers at the front are dropped
+// first, so that they do not stand in for later ones.
+//
+bool SimImpl::resumable() throw() {
+    if (!actions.empty() && slots[actions.first().slot].dead)
+	compact_now();
+    while (!observations.empty() 
+	   && !observers[observations.front().observer].active) {
+	std::pop_heap(observations.begin(), observations.end(), 
+		      LaterObservation());
+	observations.pop_back();
+    }
+    Time next = std::numeric_limits<Time>::infinity();
+    if (!actions.empty())
+	next = actions.first().time();
+    if (!observations.empty() && observations.front().time < next)
+	next = observations.front().time;
+    if (next == std::numeric_limits<Time>::infinity())
+	return false;
+    return stop_time == INIT_TIME || !(next > stop_time);
+}
+
+//
+// a process has thrown an exception out of the main loop.  The
+// context can still be cleared and reused.
+//
+void SimImpl::failed() throw() {
+    lock = false;
+    running = false;
+    trace.dump_on(TRACE_DUMP_ON_ERROR);
+}
 
+void SimImpl::loop() {
     //
     // while there is at least a scheduled action
     //
@@ -175,14 +1370,50 @@ void Sim::run_simulation() {
 	// I'm purposely excluding any kind of checks in this version
 	// of the simulator.  
 	//
+	// an action after the stop time (or the end of the current
+	// window) stays scheduled, so that the simulation can resume
+	//
+	Time next = actions.first().time();
+	if (!observations.empty() && observations.front().time <= next) {
+	    observe(next);
+	    if (!running || actions.empty())
+		continue;
+	    // the hooks may have scheduled earlier actions
+	    next = actions.first().time();
+	}
+	if (next > until || (stop_time != INIT_TIME && next > stop_time))
+	    break;
+	//
 	// I should say something like this:
 	// assert(current_time <= (*a).first);
 	//
 	Action action = actions.pop_first();
-	current_time = action.time;
-	if (stop_time != INIT_TIME && current_time > stop_time)
-	    break;
-	current_process = action.pid;
+	SSIM_COUNT(++stats.popped);
+	if (slots[action.slot].dead) {
+	    free_slot(action.slot);
+	    --dead;
+	    continue;
+	}
+	int kind = slots[action.slot].kind;
+	//
+	// the slot is freed before the action is executed, so that
+	// the handle of the current action is no longer pending.  A
+	// timer is re-armed instead, so its handle refers to the next
+	// firing.
+	//
+	const ActionSlot as = slots[action.slot];
+	if (as.timer < 0 || !rearm(action.slot, action.time())) {
+	    unlink(action.slot);
+	    free_slot(action.slot);
+	}
+	current_time = action.time();
+	current_process = as.pid;
+	if (trace.enabled())
+	    trace.record(current_time, current_process, kind, actions.size());
+	if (as.type == A_Arrival) {
+	    arrive();
+	    continue;
+	}
 	//
 	// right now I don't check if current_process is indeed a
 	// valid process.  Keep in mind that this is the heart of the
@@ -192,16 +1423,37 @@ void Sim::run_simulation() {
 	PDescr & pd = processes[current_process];
 
 	if (pd.terminated) {
+	    SSIM_COUNT(++stats.terminated);
+	    trace.dump_on(TRACE_DUMP_ON_ERROR);
 	    if (error_handler) 
-		error_handler->handle_terminated(current_process, 
-						 action.event);
+		error_handler->handle_terminated(global(current_process), 
+						 as.event);
 	} else if (current_time < pd.available_at) {
+	    SSIM_COUNT(++stats.busy);
+	    trace.dump_on(TRACE_DUMP_ON_ERROR);
 	    if (error_handler) 
-		error_handler->handle_busy(current_process, action.event);
+		error_handler->handle_busy(global(current_process), as.event);
 	} else {
-	    switch (action.type) {
+#if SSIM_STATS
+	    ++stats.executed;
+	    if (kind >= 0) {
+		if (stats.kinds.size() <= unsigned(kind))
+		    stats.kinds.resize(kind + 1, 0);
+		++stats.kinds[kind];
+	    }
+#endif
+	    switch (as.type) {
 	    case A_Event:
-		pd.process->process_event(action.event);
+		if (pd.batch) {
+		    deliver_batch(pd, as.event, action.time_key);
+		    break;
+		}
+		try {
+		    pd.process->process_event(as.event);
+		} catch (...) {
+		    release(as.event);
+		    throw;
+		}
 		break;
 	    case A_Init: 
 		pd.process->init(); 
@@ -215,6 +1467,9 @@ void Sim::run_simulation() {
 		// processes vector, rendering pd invalid
 		//
 		processes[current_process].terminated = true;
+		if (departure && processes[current_process].index >= 0)
+		    departure(processes[current_process].index);
+		drop_observers(current_process);
 		break;
 	    default:
 		//
@@ -230,63 +1485,736 @@ void Sim::run_simulation() {
 	    processes[current_process].available_at = current_time;
 	}
 
-	if (action.event != 0)
-	    if (--(action.event->refcount) == 0) 
-		delete(action.event);
+	release(as.event);
+	settle(current_process);
     }
-    lock = false;
-    running = false;
+    //
+    // observations after the last action, up to the end of the run
+    //
+    if (running && !observations.empty())
+	observe(std::numeric_limits<Time>::infinity());
+}
+
+//
+// makes the observations up to the given time, which is the time of
+// the next action or the end of the run, or up to an earlier action
+// scheduled by a hook.  The observation times of an
+// observer are increasing, so each observer has a single entry in the
+// heap, for its next observation.
+//
+void SimImpl::observe(Time limit) {
+    if (stop_time != INIT_TIME && stop_time < limit)
+	limit = stop_time;
+    if (until < limit)
+	limit = until;
+    while (running && !observations.empty() 
+	   && observations.front().time <= limit) {
+	Observation o = observations.front();
+	std::pop_heap(observations.begin(), observations.end(), 
+		      LaterObservation());
+	observations.pop_back();
+	Observer & ob = observers[o.observer];
+	if (!ob.active)
+	    continue;
+	if (++ob.next < ob.times.size()) {
+	    Observation n = { ob.times[ob.next], o.observer };
+	    observations.push_back(n);
+	    std::push_heap(observations.begin(), observations.end(), 
+			   LaterObservation());
+	}
+	current_time = o.time;
+	current_process = ob.pid;
+	ob.hook(o.time);
+	// the hook may have scheduled an action before the limit
+	if (!actions.empty() && actions.first().time() < limit)
+	    limit = actions.first().time();
+    }
+}
+
+int SimImpl::add_observer(const std::vector<Time> & times, 
+			  const ObservationHook & hook) {
+    int id = n_observers++;
+    if (observers.size() < unsigned(n_observers))
+	observers.push_back(Observer());
+    Observer & ob = observers[id];
+    ob.pid = current_process;
+    ob.times.assign(std::lower_bound(times.begin(), times.end(), current_time),
+		    times.end());
+    ob.next = 0;
+    ob.hook = hook;
+    ob.active = true;
+    if (ob.pid >= 0)
+	processes[ob.pid].observers.push_back(id);
+    if (!ob.times.empty()) {
+	Observation o = { ob.times[0], id };
+	observations.push_back(o);
+	std::push_heap(observations.begin(), observations.end(), 
+		       LaterObservation());
+    }
+    return id;
+}
+
+//
+// deactivates the observers of a stopped process, before its process
+// (and with run_concurrent(), its pid) can be reused by another one
+//
+void SimImpl::drop_observers(ProcessId p) throw() {
+    std::vector<int> & ids = processes[p].observers;
+    for (std::vector<int>::size_type i = 0; i < ids.size(); ++i)
+	observers[ids[i]].active = false;
+    ids.clear();
+}
+
+int Sim::observe(const std::vector<Time> & times, 
+		 const ObservationHook & hook) {
+    return sim().add_observer(times, hook);
+}
+
+void Sim::remove_observer(int id) throw() {
+    SimImpl & s = sim();
+    if (id >= 0 && id < s.n_observers)
+	s.observers[id].active = false;
+}
+
+//
+// delivers an event together with the events for the same process
+// that follow it in the schedule at the same time.  These are popped
+// in bulk, so they can no longer be cancelled by the handler of the
+// batch.  The caller releases the first event.
+//
+void SimImpl::deliver_batch(PDescr & pd, const Event * e, ActionKey key) {
+    batch.clear();
+    batch.push_back(e);
+    while (!actions.empty()) {
+	const Action & a = actions.first();
+	if (a.time_key != key)
+	    break;
+	ActionSlot & as = slots[a.slot];
+	if (as.dead) {
+	    free_slot(actions.pop_first().slot);
+	    SSIM_COUNT(++stats.popped);
+	    --dead;
+	    continue;
+	}
+	if (as.pid != current_process || as.type != A_Event)
+	    break;
+	unsigned k = actions.pop_first().slot;
+#if SSIM_STATS
+	++stats.popped;
+	++stats.executed;
+	if (as.kind >= 0) {
+	    if (stats.kinds.size() <= unsigned(as.kind))
+		stats.kinds.resize(as.kind + 1, 0);
+	    ++stats.kinds[as.kind];
+	}
+#endif
+	if (trace.enabled())
+	    trace.record(current_time, current_process, as.kind, actions.size());
+	batch.push_back(as.event);
+	if (as.timer < 0 || !rearm(k, current_time)) {
+	    unlink(k);
+	    free_slot(k);
+	}
+	--pd.pending;		// the process is running, so it stays
+    }
+    try {
+	pd.process->process_batch(&batch[0], batch.size());
+    } catch (...) {
+	for (std::vector<const Event *>::size_type i = 1; i < batch.size(); ++i)
+	    release(batch[i]);
+	release(e);
+	throw;
+    }
+    for (std::vector<const Event *>::size_type i = 1; i < batch.size(); ++i)
+	release(batch[i]);
+}
+
+void Sim::batch_events(bool on) throw() {
+    SimImpl & s = sim();
+    s.processes[s.current_process].batch = on;
 }
 
 void Sim::set_stop_time(Time t) throw() {
-    stop_time = t;
+    sim().stop_time = t;
+}
+
+bool Sim::run_until(Time t) {
+    return sim().run(t);
+}
+
+void Sim::resume() {
+    sim().run();
+}
+
+//
+// the state of a context saved by run_branch().  The events are
+// shared with the branch, not copied: the saved slots hold their own
+// references, which go back to the schedule on restore
+//
+struct SavedState {
+    std::vector<ActionSlot>	slots;
+    std::vector<unsigned>	free_slots;
+    std::vector<Timer>		timers;
+    std::vector<int>		free_timers;
+    ActionQueue			actions;
+    ActionQueue::size_type	dead;
+    ActionKey			sequence;
+    PsTable			processes;
+    std::vector<ProcessId>	free_pids;
+    std::vector<const Event *>	batch;
+    std::vector<std::vector<Time>::size_type> observer_next;
+    std::vector<char>		observer_active;
+    int				n_observers;
+    std::vector<Observation>	observations;
+    Time			current_time;
+    Time			until;
+    ProcessId			current_process;
+    bool			running;
+    bool			lock;
+};
+
+void SimImpl::run_branch(const boost::function<void()> & setup) {
+    SavedState saved;
+    saved.slots = slots;
+    saved.free_slots = free_slots;
+    saved.timers = timers;
+    saved.free_timers = free_timers;
+    saved.actions = actions;
+    saved.dead = dead;
+    saved.sequence = sequence;
+    saved.processes = processes;
+    saved.free_pids = free_pids;
+    saved.batch.swap(batch);	// the current batch is still being delivered
+    //
+    // only the positions of the observers are saved, since a hook
+    // may be running (a branch run from an observation)
+    //
+    for (int i = 0; i < n_observers; ++i) {
+	saved.observer_next.push_back(observers[i].next);
+	saved.observer_active.push_back(observers[i].active);
+    }
+    saved.n_observers = n_observers;
+    saved.observations = observations;
+    saved.current_time = current_time;
+    saved.until = until;
+    saved.current_process = current_process;
+    saved.running = running;
+    saved.lock = lock;
+    for(ActionQueue::size_type i = 0; i < actions.size(); ++i) {
+	const Event * e = slots[actions[i].slot].event;
+	if (e != 0) 
+	    ++(e->refcount);
+    }
+    lock = true;
+    running = true;
+    until = std::numeric_limits<Time>::infinity();
+    std::exception_ptr error;
+    try {
+	setup();
+	loop();
+    } catch (...) {
+	error = std::current_exception();
+    }
+    //
+    // drops what is left of the branch, then puts everything back
+    //
+    for(ActionQueue::size_type i = 0; i < actions.size(); ++i)
+	release(slots[actions[i].slot].event);
+    slots.swap(saved.slots);
+    //
+    // generations are not rewound, so that the handles of the branch
+    // stay stale: the slots that are free now, and the slots freed
+    // or added later, get generations beyond any of the branch
+    //
+    for(std::vector<ActionSlot>::size_type k = 0; k < saved.slots.size(); ++k)
+	if (saved.slots[k].generation >= generation_floor)
+	    generation_floor = saved.slots[k].generation + 1;
+    for(std::vector<unsigned>::size_type i = 0; i < saved.free_slots.size(); ++i) {
+	ActionSlot & as = slots[saved.free_slots[i]];
+	if (as.generation < generation_floor)
+	    as.generation = generation_floor;
+    }
+    free_slots.swap(saved.free_slots);
+    timers.swap(saved.timers);
+    free_timers.swap(saved.free_timers);
+    actions = saved.actions;
+    dead = saved.dead;
+    sequence = saved.sequence;
+    processes.swap(saved.processes);
+    free_pids.swap(saved.free_pids);
+    batch.swap(saved.batch);
+    n_observers = saved.n_observers;
+    for (int i = 0; i < n_observers; ++i) {
+	observers[i].next = saved.observer_next[i];
+	observers[i].active = saved.observer_active[i];
+    }
+    observations.swap(saved.observations);
+    current_time = saved.current_time;
+    until = saved.until;
+    current_process = saved.current_process;
+    running = saved.running;
+    lock = saved.lock;
+    if (error) 
+	std::rethrow_exception(error);
+}
+
+void Sim::run_branch(const boost::function<void()> & setup) {
+    sim().run_branch(setup);
 }
 
 void Sim::stop_process() throw() {
-    SimImpl::schedule_now(A_Stop, current_process); 
+    SimImpl & s = sim();
+    s.schedule_now(A_Stop, s.current_process); 
 }
 
 int Sim::stop_process(ProcessId pid) throw() {
-    if (processes[pid].terminated) return -1;
-    SimImpl::schedule_now(A_Stop, pid); 
+    SimImpl & s = sim();
+    pid = s.local(pid);
+    if (pid == NULL_PROCESSID || s.processes[pid].terminated) return -1;
+    s.schedule_now(A_Stop, pid); 
     return 0;
 }
 
 void Sim::stop_simulation() throw() {
-    running = false;
+    SimImpl & s = sim();
+    s.running = false;
+    s.trace.dump_on(TRACE_DUMP_ON_STOP);
+}
+
+void Sim::set_trace(std::size_t capacity, const std::string & file, 
+		    int flags) {
+    sim().trace.configure(capacity, file, flags);
+}
+
+void Sim::set_trace_person(int id) throw() {
+    sim().trace.person = id;
+}
+
+bool Sim::dump_trace(const std::string & file) throw() {
+    SimImpl & s = sim();
+    return s.trace.dump(file.empty() ? s.trace.file : file);
 }
 
 void Sim::advance_delay(Time delay) throw() {
-    if (!running) return;
-    current_time += delay;
+    SimImpl & s = sim();
+    if (!s.running) return;
+    s.current_time += delay;
 }
 
 ProcessId Sim::this_process() throw() {
-    return current_process;
+    SimImpl & s = sim();
+    return s.global(s.current_process);
 }
 
 Time Sim::clock() throw() {
-    return current_time;
+    return sim().current_time;
+}
+
+EventHandle Sim::self_signal_event(const Event * e) throw() {
+    SimImpl & s = sim();
+    return s.schedule_now(A_Event, s.current_process, e);
+}
+
+EventHandle Sim::self_signal_event(const Event * e, Time d) throw() {
+    SimImpl & s = sim();
+    return s.schedule(d, A_Event, s.current_process, e);
+}
+
+EventHandle Sim::signal_event(ProcessId pid, const Event * e) throw() {
+    SimImpl & s = sim();
+    return s.signal(pid, s.current_time, e, EventTag());
+}
+
+EventHandle Sim::signal_event(ProcessId pid, const Event * e, Time d) throw() {
+    SimImpl & s = sim();
+    return s.signal(pid, s.current_time + d, e, EventTag());
+}
+
+EventHandle Sim::self_signal_event(const Event * e, Time d, 
+				   EventTag tag) throw() {
+    SimImpl & s = sim();
+    return s.schedule(d, A_Event, s.current_process, e, tag);
+}
+
+EventHandle Sim::signal_event(ProcessId pid, const Event * e, Time d, 
+			      EventTag tag) throw() {
+    SimImpl & s = sim();
+    return s.signal(pid, s.current_time + d, e, tag);
+}
+
+EventHandle Sim::self_signal_timer(const Event * e, Time delay, 
+				   Time period, Time stop, 
+				   EventTag tag) throw() {
+    SimImpl & s = sim();
+    return s.schedule_timer(s.current_time + delay, s.current_process, 
+			    e, tag, period, stop);
+}
+
+void Sim::self_signal_events(const Event * const * events, 
+			     const Time * delays, const EventTag * tags, 
+			     unsigned n, EventHandle * handles) throw() {
+    sim().schedule_bulk(events, delays, tags, n, handles);
+}
+
+//
+// the actions get their sequence numbers in order, exactly as if they
+// were scheduled one by one, and are then added to the event list
+// together, so that the heaps can restore their order in one pass
+//
+void SimImpl::schedule_bulk(const Event * const * events, 
+			    const Time * delays, const EventTag * tags, 
+			    unsigned n, EventHandle * handles) throw() {
+    bulk.clear();
+    for (unsigned i = 0; i < n; ++i) {
+	EventTag tag = tags ? tags[i] : EventTag();
+	unsigned k = new_slot(A_Event, current_process, events[i], tag);
+	bulk.push_back(Action(time_key(current_time + delays[i]), 
+			      order_key(tag.priority, sequence++), k));
+	SSIM_COUNT(stats.out_of_order += actions.late(bulk.back()));
+	if (handles) 
+	    handles[i] = EventHandle(k, slots[k].generation);
+    }
+    actions.insert_bulk(bulk.begin(), bulk.end());
+    SSIM_COUNT(stats.inserts += n);
+    SSIM_COUNT(stats.max_queue = std::max(stats.max_queue, 
+					  actions.size()));
 }
 
-void Sim::self_signal_event(const Event * e) throw() {
-    SimImpl::schedule_now(A_Event, current_process, e);
+unsigned Sim::remove_kind(ProcessId pid, int kind) throw() {
+    SimImpl & s = sim();
+    pid = s.local(pid);
+    if (pid == NULL_PROCESSID) return 0;
+    return s.remove_all(s.processes[pid].kinds, kind);
 }
 
-void Sim::self_signal_event(const Event * e, Time d) throw() {
-    SimImpl::schedule(d, A_Event, current_process, e);
+unsigned Sim::remove_symbol(ProcessId pid, int symbol) throw() {
+    SimImpl & s = sim();
+    pid = s.local(pid);
+    if (pid == NULL_PROCESSID) return 0;
+    return s.remove_all(s.processes[pid].symbols, symbol);
 }
 
-void Sim::signal_event(ProcessId pid, const Event * e) throw() {
-    SimImpl::schedule_now(A_Event, pid, e);
+unsigned Sim::pending_kind(ProcessId pid, int kind) throw() {
+    SimImpl & s = sim();
+    pid = s.local(pid);
+    if (pid == NULL_PROCESSID) return 0;
+    return SimImpl::count(s.processes[pid].kinds, kind);
+}
+
+unsigned Sim::pending_symbol(ProcessId pid, int symbol) throw() {
+    SimImpl & s = sim();
+    pid = s.local(pid);
+    if (pid == NULL_PROCESSID) return 0;
+    return SimImpl::count(s.processes[pid].symbols, symbol);
+}
+
+//
+// conservative parallel execution.  The partitions advance in
+// windows [T, T + lookahead), where T is the earliest pending action
+// over all partitions.  An event for another partition is delayed by
+// at least the lookahead, so it falls after the current window, and
+// it can wait in the outbox of its sender until the end of the
+// window.  Each outbox has a single writer during a window and a
+// single reader between windows, with barriers in between, so the
+// outboxes need no locks.
+//
+class Barrier {
+public:
+    Barrier(int n, const boost::function<void ()> & f) 
+	: parties(n), waiting(0), phase(0), completion(f) {}
+
+    // the last thread to arrive runs the completion, then releases
+    // the others
+    void wait() {
+	std::unique_lock<std::mutex> guard(lock);
+	unsigned long long current = phase;
+	if (++waiting == parties) {
+	    completion();
+	    waiting = 0;
+	    ++phase;
+	    released.notify_all();
+	} else {
+	    while (phase == current)
+		released.wait(guard);
+	}
+    }
+
+private:
+    int parties;
+    int waiting;
+    unsigned long long phase;
+    boost::function<void ()> completion;
+    std::mutex lock;
+    std::condition_variable released;
+};
+
+class ParallelImpl {
+public:
+    ParallelImpl(int n, Time l) 
+	: lookahead(l), stop_time(INIT_TIME), horizon(0), 
+	  window_count(0), done(false), 
+	  outbox(n, std::vector<std::vector<Mail> >(n)), 
+	  next(n), stopped(n), late(n),
+	  barrier(n, boost::bind(&ParallelImpl::advance, this)) {
+	for (int k = 0; k < n; ++k) {
+	    contexts.push_back(new SimContext());
+	    SimImpl & s = impl(k);
+	    s.parallel = this;
+	    s.partition = k;
+	    s.partitions = n;
+	}
+    }
+
+    ~ParallelImpl() {
+	//
+	// events may be owned by the arena of another partition, so
+	// all the schedules are cleared before any arena goes away
+	//
+	for (std::vector<SimContext *>::size_type k = 0; k < contexts.size(); ++k) {
+	    SimContext::Scope scope(contexts[k]);
+	    impl(k).clear();
+	}
+	for (std::vector<SimContext *>::size_type k = 0; k < contexts.size(); ++k)
+	    delete contexts[k];
+    }
+
+    SimImpl & impl(int k) throw() { return *(contexts[k]->impl); }
+
+    void run();
+    void worker(int k);
+    void advance() throw();
+    void deliver(int k) throw();
+
+    std::vector<SimContext *>	contexts;
+    Time			lookahead;
+    Time			stop_time;
+    Time			horizon;	// last time of the current window
+    unsigned long long		window_count;
+    bool			done;
+    std::vector<std::vector<std::vector<Mail> > > outbox; // [from][to]
+    std::vector<Time>		next;		// earliest action, by partition
+    std::vector<char>		stopped;	// by stop_simulation()
+    std::vector<char>		late;		// delays shorter than the lookahead
+    std::exception_ptr		error;
+    std::mutex			error_lock;
+    Barrier			barrier;
+};
+
+void SimImpl::post(ProcessId p, Time t, const Event * e, 
+		   const EventTag & tag) throw() {
+    if (t - current_time < parallel->lookahead)
+	parallel->late[partition] = true;
+    Mail m;
+    m.time = t;
+    m.sent = current_time;
+    m.pid = p / partitions;
+    m.event = e;
+    m.tag = tag;
+    parallel->outbox[partition][p % partitions].push_back(m);
+}
+
+//
+// schedules the events sent to partition k in the last window, in
+// sending order (the outboxes are read in partition order, so that
+// the result does not depend on the timing of the threads)
+//
+void ParallelImpl::deliver(int k) throw() {
+    SimImpl & s = impl(k);
+    std::vector<Mail> inbox;
+    for (std::vector<Mail>::size_type q = 0; q < outbox.size(); ++q) {
+	std::vector<Mail> & box = outbox[q][k];
+	inbox.insert(inbox.end(), box.begin(), box.end());
+	box.clear();
+    }
+    std::stable_sort(inbox.begin(), inbox.end());
+    for (std::vector<Mail>::size_type i = 0; i < inbox.size(); ++i) {
+	const Mail & m = inbox[i];
+	s.schedule_at(m.time, A_Event, m.pid, m.event, m.tag);
+    }
+}
+
+//
+// runs between windows, in the last thread to reach the barrier
+//
+void ParallelImpl::advance() throw() {
+    Time t = std::numeric_limits<Time>::infinity();
+    bool stop = false;
+    for (std::vector<Time>::size_type k = 0; k < next.size(); ++k) {
+	t = std::min(t, next[k]);
+	stop = stop || stopped[k];
+	if (late[k] && !error)
+	    error = std::make_exception_ptr(std::logic_error(
+		"ssim: event for another partition with a delay shorter than the lookahead"));
+    }
+    done = stop || error || t == std::numeric_limits<Time>::infinity()
+	|| (stop_time != INIT_TIME && t > stop_time);
+    horizon = std::max(t, std::nextafter(t + lookahead, t));
+    if (stop_time != INIT_TIME)
+	horizon = std::min(horizon, stop_time);
+    if (!done)
+	++window_count;
+}
+
+void ParallelImpl::worker(int k) {
+    SimContext::Scope scope(contexts[k]);
+    SimImpl & s = impl(k);
+    for (;;) {
+	next[k] = s.actions.empty() 
+	    ? std::numeric_limits<Time>::infinity() : s.actions.first().time();
+	stopped[k] = !s.running;
+	barrier.wait();
+	if (done) 
+	    break;
+	s.until = horizon;
+	try {
+	    s.loop();
+	} catch (...) {
+	    s.trace.dump_on(TRACE_DUMP_ON_ERROR);
+	    s.running = false;
+	    std::lock_guard<std::mutex> guard(error_lock);
+	    if (!error) 
+		error = std::current_exception();
+	}
+	barrier.wait();
+	deliver(k);
+    }
+}
+
+void ParallelImpl::run() {
+    int n = contexts.size();
+    for (int k = 0; k < n; ++k)
+	if (impl(k).lock)
+	    throw std::logic_error("ssim: ParallelSim::run() called while a partition is running");
+    for (int k = 0; k < n; ++k) {
+	SimImpl & s = impl(k);
+	s.lock = true;
+	s.running = true;
+	late[k] = false;
+    }
+    done = false;
+    error = std::exception_ptr();
+    //
+    // the calling thread runs the first partition
+    //
+    std::vector<std::thread> threads;
+    for (int k = 1; k < n; ++k)
+	threads.push_back(std::thread(&ParallelImpl::worker, this, k));
+    worker(0);
+    for (std::vector<std::thread>::size_type i = 0; i < threads.size(); ++i)
+	threads[i].join();
+    for (int k = 0; k < n; ++k) {
+	impl(k).lock = false;
+	impl(k).running = false;
+	impl(k).until = std::numeric_limits<Time>::infinity();
+    }
+    if (error)
+	std::rethrow_exception(error);
+}
+
+ParallelSim::ParallelSim(int partitions, Time lookahead) {
+    if (partitions < 1)
+	throw std::invalid_argument("ssim: ParallelSim needs at least one partition");
+    if (!(lookahead > 0))
+	throw std::invalid_argument("ssim: ParallelSim needs a positive lookahead");
+    impl = new ParallelImpl(partitions, lookahead);
+}
+
+ParallelSim::~ParallelSim() {
+    delete impl;
+}
+
+int ParallelSim::partitions() const throw() {
+    return impl->contexts.size();
+}
+
+Time ParallelSim::lookahead() const throw() {
+    return impl->lookahead;
+}
+
+SimContext * ParallelSim::context(int partition) throw() {
+    return impl->contexts[partition];
+}
+
+int ParallelSim::partition(ProcessId pid) const throw() {
+    return pid % partitions();
+}
+
+ProcessId ParallelSim::create_process(int partition, Process * p) {
+    SimContext::Scope scope(impl->contexts[partition]);
+    return Sim::create_process(p);
+}
+
+void ParallelSim::set_stop_time(Time t) throw() {
+    impl->stop_time = t;
+}
+
+void ParallelSim::run() {
+    impl->run();
+}
+
+unsigned long long ParallelSim::windows() const throw() {
+    return impl->window_count;
+}
+
+//
+// symbols are shared by all contexts.  Names are appended to blocks
+// that never move, and published by the count, so reading a name
+// takes no lock.  Each thread also caches the symbols of the names
+// it interned, so the table is locked (and searched) only the first
+// time a thread interns a name, and named messages can be built in
+// a loop without contention between the threads of a ParallelSim.
+//
+static const unsigned SymbolBlockBits = 10;
+static const unsigned SymbolBlockSize = 1u << SymbolBlockBits;
+static const unsigned SymbolBlocks = 4096;
+
+static std::mutex symbols_lock;
+static std::map<std::string, int> symbol_ids;
+static std::atomic<std::string *> symbol_blocks[SymbolBlocks];
+static std::atomic<int> symbol_count(0);
+
+int Sim::symbol(const std::string & name) {
+    if (name.empty()) 
+	return -1;
+    static thread_local std::map<std::string, int> cached;
+    std::map<std::string, int>::const_iterator c = cached.find(name);
+    if (c != cached.end())
+	return c->second;
+
+    std::lock_guard<std::mutex> guard(symbols_lock);
+    std::map<std::string, int>::const_iterator i = symbol_ids.find(name);
+    int id;
+    if (i != symbol_ids.end()) {
+	id = i->second;
+    } else {
+	id = symbol_count.load(std::memory_order_relaxed);
+	unsigned block = unsigned(id) >> SymbolBlockBits;
+	if (block >= SymbolBlocks)
+	    throw std::length_error("ssim: too many symbols");
+	std::string * names = symbol_blocks[block].load(std::memory_order_relaxed);
+	if (names == 0) {
+	    names = new std::string[SymbolBlockSize];
+	    symbol_blocks[block].store(names, std::memory_order_relaxed);
+	}
+	names[id & (SymbolBlockSize - 1)] = name;
+	symbol_ids.insert(std::make_pair(name, id));
+	// publishes the name (and its block) to symbol_name()
+	symbol_count.store(id + 1, std::memory_order_release);
+    }
+    cached.insert(std::make_pair(name, id));
+    return id;
 }
 
-void Sim::signal_event(ProcessId pid, const Event * e, Time d) throw() {
-    SimImpl::schedule(d, A_Event, pid, e);
+const std::string & Sim::symbol_name(int symbol) {
+    static const std::string none;
+    if (symbol < 0 || symbol >= symbol_count.load(std::memory_order_acquire))
+	return none;
+    std::string * names = symbol_blocks[unsigned(symbol) >> SymbolBlockBits].load(std::memory_order_relaxed);
+    return names[symbol & (SymbolBlockSize - 1)];
 }
 
 void Sim::set_error_handler(SimErrorHandler * eh) throw() {
-    error_handler = eh;
+    sim().error_handler = eh;
 }
 
   ProcessId ProcessWithPId::activate() throw() {
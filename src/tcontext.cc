@@ -0,0 +1,144 @@
+// -*-C++-*-
+//
+//  This file is part of SSim, a simple discrete-event simulator.
+//  See http://www.inf.usi.ch/carzaniga/ssim/
+//
+//  SSim is free software: you can redistribute it and/or modify it under
+//  the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your
+//  option) any later version.
+//
+//  SSim is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with SSim.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <siena/tcontext.h>
+
+#if SSIM_NATIVE_TCONTEXT
+
+#include <cstring>
+
+//
+// The switch pushes the callee-saved registers of the calling
+// context on its own stack, stores the stack pointer in *from, loads
+// the stack pointer from to, and pops the registers of the resumed
+// context.  A new context is a stack prepared by tcontext_make() so
+// that the first switch to it "returns" into ssim_tcontext_start,
+// which finds the entry function and its argument in callee-saved
+// registers.
+//
+#ifdef __APPLE__
+#define SSIM_ASM_SYMBOL(name) "_" #name
+#define SSIM_ASM_FUNCTION(name) \
+    ".globl " SSIM_ASM_SYMBOL(name) "\n" \
+    ".p2align 4\n" \
+    SSIM_ASM_SYMBOL(name) ":\n"
+#else
+#define SSIM_ASM_SYMBOL(name) #name
+#define SSIM_ASM_FUNCTION(name) \
+    ".globl " SSIM_ASM_SYMBOL(name) "\n" \
+    ".hidden " SSIM_ASM_SYMBOL(name) "\n" \
+    ".type " SSIM_ASM_SYMBOL(name) ", %function\n" \
+    ".p2align 4\n" \
+    SSIM_ASM_SYMBOL(name) ":\n"
+#endif
+
+extern "C" void ssim_tcontext_start();
+
+#if defined(__x86_64__)
+
+// frame: r15, r14, r13, r12, rbx, rbp, return address.  The mxcsr
+// and x87 control word are not switched: simulations do not change
+// floating-point modes per process, and reloading them costs more
+// than the rest of the switch.
+static const int FrameWords = 7;
+
+asm(".text\n"
+    SSIM_ASM_FUNCTION(ssim_tcontext_switch)
+    "	pushq %rbp\n"
+    "	pushq %rbx\n"
+    "	pushq %r12\n"
+    "	pushq %r13\n"
+    "	pushq %r14\n"
+    "	pushq %r15\n"
+    "	movq %rsp, (%rdi)\n"
+    "	movq %rsi, %rsp\n"
+    "	popq %r15\n"
+    "	popq %r14\n"
+    "	popq %r13\n"
+    "	popq %r12\n"
+    "	popq %rbx\n"
+    "	popq %rbp\n"
+    "	ret\n"
+    SSIM_ASM_FUNCTION(ssim_tcontext_start)
+    "	movq %r13, %rdi\n"
+    "	callq *%r12\n"
+    "	ud2\n");
+
+#elif defined(__aarch64__)
+
+// frame: x19-x28, x29 (frame pointer), x30 (link register), d8-d15
+static const int FrameWords = 20;
+
+asm(".text\n"
+    SSIM_ASM_FUNCTION(ssim_tcontext_switch)
+    "	sub sp, sp, #160\n"
+    "	stp x19, x20, [sp, #0]\n"
+    "	stp x21, x22, [sp, #16]\n"
+    "	stp x23, x24, [sp, #32]\n"
+    "	stp x25, x26, [sp, #48]\n"
+    "	stp x27, x28, [sp, #64]\n"
+    "	stp x29, x30, [sp, #80]\n"
+    "	stp d8, d9, [sp, #96]\n"
+    "	stp d10, d11, [sp, #112]\n"
+    "	stp d12, d13, [sp, #128]\n"
+    "	stp d14, d15, [sp, #144]\n"
+    "	mov x2, sp\n"
+    "	str x2, [x0]\n"
+    "	mov sp, x1\n"
+    "	ldp x19, x20, [sp, #0]\n"
+    "	ldp x21, x22, [sp, #16]\n"
+    "	ldp x23, x24, [sp, #32]\n"
+    "	ldp x25, x26, [sp, #48]\n"
+    "	ldp x27, x28, [sp, #64]\n"
+    "	ldp x29, x30, [sp, #80]\n"
+    "	ldp d8, d9, [sp, #96]\n"
+    "	ldp d10, d11, [sp, #112]\n"
+    "	ldp d12, d13, [sp, #128]\n"
+    "	ldp d14, d15, [sp, #144]\n"
+    "	add sp, sp, #160\n"
+    "	ret\n"
+    SSIM_ASM_FUNCTION(ssim_tcontext_start)
+    "	mov x0, x20\n"
+    "	blr x19\n"
+    "	brk #0\n");
+
+#endif
+
+namespace ssim {
+
+tcontext_t tcontext_make(char * stack, unsigned long size,
+			 void (*entry)(void *), void * arg) {
+    // the top of the stack, 16-byte aligned, with 16 bytes to spare
+    unsigned long top = (reinterpret_cast<unsigned long>(stack) + size) & ~15UL;
+    void ** frame = reinterpret_cast<void **>(top - 16) - FrameWords;
+    std::memset(frame, 0, FrameWords * sizeof(void *));
+#if defined(__x86_64__)
+    frame[3] = reinterpret_cast<void *>(entry);	// r12
+    frame[2] = arg;				// r13
+    frame[6] = reinterpret_cast<void *>(ssim_tcontext_start);
+#else
+    frame[0] = reinterpret_cast<void *>(entry);	// x19
+    frame[1] = arg;				// x20
+    frame[11] = reinterpret_cast<void *>(ssim_tcontext_start); // x30
+#endif
+    return frame;
+}
+
+}; // namespace ssim
+
+#endif // SSIM_NATIVE_TCONTEXT
@@ -22,6 +22,17 @@
 //  You should have received a copy of the GNU General Public License
 //  along with SSim.  If not, see <http://www.gnu.org/licenses/>.
 //
+#define TPROCESS_OPTIONAL
+#ifndef TPROCESS_IMPL
+#include "tprocessconf.h"
+#endif
+
+// the fortified longjmp() rejects jumps between the stacks of
+// different processes, which is what TPROCESS_IMPL 2 does
+#if TPROCESS_IMPL==2
+#undef _FORTIFY_SOURCE
+#endif
+
 #include <siena/tprocess.h>
 
 #if TPROCESS_IMPL==0
@@ -29,9 +40,17 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 #if TPROCESS_IMPL==1
 #include <ucontext.h>
+#elif TPROCESS_IMPL==3
+#include <siena/tcontext.h>
 #else
 #include <setjmp.h>
 #include <signal.h>
@@ -44,25 +63,159 @@ namespace ssim {
 static TProcess * current_tprocess = 0;
 
 unsigned long TProcess::DefaultStackSize = 8 * 1024;
+bool TProcess::StackGuard = true;
 
 #if TPROCESS_IMPL==1
 static ucontext_t resume_ctx;
+#elif TPROCESS_IMPL==3
+static tcontext_t resume_ctx;
 #else
 static jmp_buf resume_ctx; 
 #endif
 
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+//
+// stacks are mapped with mmap(), StacksPerChunk at a time, each one
+// with an inaccessible guard page below it when StackGuard is set.
+// Free stacks are kept in a pool per size and guard setting.  The
+// memory of a fresh mapping is zero, so the usage of a stack is the
+// extent of its non-zero words when scanning up from its bottom.  A
+// stack is zeroed again over that extent when it goes back to the
+// pool, so the same holds for a reused stack.
+//
+static const unsigned long StacksPerChunk = 16;
+
+struct StackPool {
+    std::vector<char *> free;
+    std::vector<char *> chunks;
+    unsigned long chunk_size;
+    unsigned long in_use;
+    StackPool() : chunk_size(0), in_use(0) {}
+};
+
+typedef std::map<unsigned long, StackPool> stack_pools_t;
+
+static stack_pools_t stack_pools;
+static unsigned long n_stacks_in_use = 0;
+static unsigned long n_stacks_mapped = 0;
+static unsigned long high_water = 0;
+
+static unsigned long page_size() {
+    static unsigned long size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+static unsigned long round_stack_size(unsigned long size) {
+    unsigned long page = page_size();
+    return size == 0 ? page : (size + page - 1) / page * page;
+}
+
+// the key of a pool: the size is a multiple of the page size, which
+// leaves the low bit for the guard setting
+static unsigned long pool_key(unsigned long size, bool guard) {
+    return size | (guard ? 1 : 0);
+}
+
+static char * acquire_stack(unsigned long size, bool & guarded) {
+    guarded = TProcess::StackGuard;
+    StackPool & pool = stack_pools[pool_key(size, guarded)];
+    if (pool.free.empty()) {
+	unsigned long guard = guarded ? page_size() : 0;
+	unsigned long slot = guard + size;
+	void * chunk = mmap(0, slot * StacksPerChunk, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (chunk == MAP_FAILED) {
+	    perror("TProcess: mmap failed for a stack");
+	    return 0;
+	}
+	char * base = static_cast<char *>(chunk);
+	pool.chunk_size = slot * StacksPerChunk;
+	pool.chunks.push_back(base);
+	// hand out the lowest stack first
+	for (unsigned long i = StacksPerChunk; i > 0; --i) {
+	    char * s = base + (i - 1) * slot;
+	    if (TProcess::StackGuard && mprotect(s, guard, PROT_NONE) < 0) {
+		// most likely out of memory mappings: warn once and
+		// map further stacks without guard pages
+		perror("TProcess: mprotect failed for a guard page, further stacks are unguarded");
+		TProcess::StackGuard = false;
+	    }
+	    pool.free.push_back(s + guard);
+	}
+	n_stacks_mapped += StacksPerChunk;
+    }
+    char * stack = pool.free.back();
+    pool.free.pop_back();
+    ++pool.in_use;
+    ++n_stacks_in_use;
+    return stack;
+}
+
+static void release_stack(char * stack, unsigned long size, bool guard) {
+    const unsigned long * p = reinterpret_cast<const unsigned long *>(stack);
+    const unsigned long * end = reinterpret_cast<const unsigned long *>(stack + size);
+    while (p < end && *p == 0)
+	++p;
+    unsigned long used = reinterpret_cast<const char *>(end) - reinterpret_cast<const char *>(p);
+    if (used > high_water)
+	high_water = used;
+    std::memset(stack + size - used, 0, used);
+
+    StackPool & pool = stack_pools[pool_key(size, guard)];
+    pool.free.push_back(stack);
+    --pool.in_use;
+    --n_stacks_in_use;
+}
+
+unsigned long TProcess::stacks_in_use() {
+    return n_stacks_in_use;
+}
+
+unsigned long TProcess::stacks_mapped() {
+    return n_stacks_mapped;
+}
+
+unsigned long TProcess::stack_high_water() {
+    return high_water;
+}
+
+void TProcess::reset_stack_high_water() {
+    high_water = 0;
+}
+
+void TProcess::release_stacks() {
+    stack_pools_t::iterator i = stack_pools.begin();
+    while (i != stack_pools.end()) {
+	StackPool & pool = i->second;
+	if (pool.in_use > 0) {
+	    ++i;
+	    continue;
+	}
+	for (std::vector<char *>::iterator c = pool.chunks.begin(); c != pool.chunks.end(); ++c)
+	    munmap(*c, pool.chunk_size);
+	n_stacks_mapped -= pool.free.size();
+	stack_pools.erase(i++);
+    }
+}
+
 TProcess::TProcess(unsigned long size) {
-    mystack_size = size;
-    mystack = new char[mystack_size];
+    mystack_size = round_stack_size(size);
+    mystack = 0;
+    mystack_guard = false;
 }
 
 TProcess::TProcess() {
-    mystack_size = DefaultStackSize;
-    mystack = new char[mystack_size];
+    mystack_size = round_stack_size(DefaultStackSize);
+    mystack = 0;
+    mystack_guard = false;
 }
 
 TProcess::~TProcess() {
-    delete(mystack);
+    if (mystack)
+	release_stack(mystack, mystack_size, mystack_guard);
 }
 
 void TProcess::resume() {
@@ -74,6 +227,8 @@ void TProcess::resume() {
 	// ...work in progress...
 	perror("TProcess::resume: swapcontext failed");
     }
+#elif TPROCESS_IMPL==3
+    tcontext_switch(&resume_ctx, running_ctx);
 #else
     if (!setjmp(resume_ctx)) {
 	longjmp(running_ctx, 1);
@@ -94,6 +249,8 @@ void TProcess::pause() {
 	perror("TProcess::pause: swapcontext failed");
 	return;
     }
+#elif TPROCESS_IMPL==3
+    tcontext_switch(&running_ctx, resume_ctx);
 #else
     if (!setjmp(running_ctx)) {
 	longjmp(resume_ctx, 1);
@@ -116,6 +273,17 @@ void TProcess::starter() {
     // Sim::stop_process()
     assert(false);
 }
+#elif TPROCESS_IMPL==3
+void TProcess::starter(void * arg) {
+    TProcess * p = static_cast<TProcess *>(arg);
+    p->main();
+    Sim::stop_process();
+    p->pause();
+    // we should never get to this point, because the simulator should
+    // never call process_event or process_timeout after we call
+    // Sim::stop_process()
+    assert(false);
+}
 #else
 void TProcess::starter(int) {
     TProcess * p = current_tprocess;
@@ -132,13 +300,20 @@ void TProcess::starter(int) {
 #endif
 
 void TProcess::init() {
+    if (!mystack) {
+	mystack = acquire_stack(mystack_size, mystack_guard);
+	if (!mystack)
+	    return;
+    }
     //
     // this method creates the "execution context" for the thread that
-    // executes this TProcess.  We can use two types of
+    // executes this TProcess.  We can use three types of
     // implementations.  The first one is based on the "ucontext"
     // functions makecontext(), getcontext(), and swapcontext().  The
     // second implementation is based on a combination of POSIX
-    // functions.
+    // functions.  The third one switches stacks with a few
+    // instructions (see tcontext.h), so unlike swapcontext() it makes
+    // no system call to save and restore the signal mask.
     //
 #if TPROCESS_IMPL==1
     // this method uses makecontext and swapcontext and is pretty
@@ -159,6 +334,10 @@ void TProcess::init() {
 	perror("TProcess::init: swapcontext failed");
 	return;
     } 
+#elif TPROCESS_IMPL==3
+    running_ctx = tcontext_make(mystack, mystack_size, TProcess::starter, this);
+    current_tprocess = this;
+    resume();				// switch to the newly created context
 #else
     // this method exploits a signal handler to create a different
     // execution context (on a different stack), and then uses
@@ -188,6 +367,8 @@ void TProcess::init() {
 }
 
 void TProcess::process_event(const Event * msg) {
+    if (!mystack)
+	return;
     ev = msg;
     resume();
 }
@@ -211,7 +392,16 @@ const Event * TProcess::wait_for_event(Time timeout) {
     return msg;
 }
 
-void TProcess::stop() { };
+void TProcess::stop() {
+    //
+    // the kernel calls stop() from its own context, and the process
+    // will never be resumed, so its stack can go back to the pool
+    //
+    if (mystack) {
+	release_stack(mystack, mystack_size, mystack_guard);
+	mystack = 0;
+    }
+}
 
 }; // namespace ssim
 
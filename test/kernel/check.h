@@ -0,0 +1,38 @@
+// -*-C++-*-
+//
+//  checks for the kernel tests.  A test program counts the checks
+//  that fail, prints them, and exits with a non-zero status if any
+//  failed.
+//
+#ifndef _check_h
+#define _check_h
+
+#include <cstdio>
+
+static int check_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+	if (!(cond)) { \
+	    ++check_failures; \
+	    std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+	} \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+	if (!((a) == (b))) { \
+	    ++check_failures; \
+	    std::printf("%s:%d: check failed: %s == %s\n", __FILE__, __LINE__, #a, #b); \
+	} \
+    } while (0)
+
+static inline int check_result(const char * test) {
+    if (check_failures == 0) 
+	std::printf("%s: ok\n", test);
+    else
+	std::printf("%s: %d checks failed\n", test, check_failures);
+    return check_failures != 0;
+}
+
+#endif /* _check_h */
@@ -0,0 +1,21 @@
+//
+// the kernel prints its debugging output through R.  The tests run
+// outside of R, so they print to the standard streams instead.
+//
+#include <cstdarg>
+#include <cstdio>
+#include <R.h>
+
+extern "C" void Rprintf(const char * format, ...) {
+    va_list args;
+    va_start(args, format);
+    std::vprintf(format, args);
+    va_end(args);
+}
+
+extern "C" void REprintf(const char * format, ...) {
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stderr, format, args);
+    va_end(args);
+}
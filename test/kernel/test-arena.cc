@@ -0,0 +1,36 @@
+//
+// blocks of the event arena that outlive their context: the arena of
+// a thread is retired when the thread ends, and the blocks still live
+// go back to it later, from another thread.
+//
+#include <thread>
+#include <vector>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+int main() {
+    std::vector<void *> blocks;
+    std::thread t([&blocks]() {
+	    for (int i = 0; i < 100; ++i)
+		blocks.push_back(Sim::allocate(16 + 8*i));
+	    Sim::deallocate(blocks.back());
+	    blocks.pop_back();
+	});
+    t.join();
+    //
+    // the context of the thread is gone, its arena is not.  Under
+    // SANITIZE=address, a use of the arena after it is freed fails.
+    //
+    CHECK_EQ(blocks.size(), 99u);
+    for (std::vector<void *>::size_type i = 0; i < blocks.size(); ++i)
+	Sim::deallocate(blocks[i]);
+
+    // a thread that ends with no live block deletes its arena at once
+    std::thread u([]() { Sim::deallocate(Sim::allocate(32)); });
+    u.join();
+
+    return check_result("test-arena");
+}
@@ -0,0 +1,94 @@
+//
+// counterfactual branches (Sim::run_branch()): the main run carries
+// on as if the branch never ran, and the handles obtained in the
+// branch stay stale afterwards, also when the main run recycles the
+// slots that the branch used.
+//
+#include <vector>
+#include <boost/bind/bind.hpp>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+class Step : public Event {
+public:
+    Step(int k) : kind(k) {}
+    int kind;
+};
+
+enum { Treatment, Death, Follow, Extra };
+
+class Person : public Process {
+public:
+    std::vector<std::pair<Time, int> > history;
+    bool branching;
+    bool in_branch;
+    EventHandle death;
+    EventHandle extra;		// obtained in the branch
+    EventHandle follow;		// obtained in the branch, after death
+    bool extra_pending, follow_pending;
+
+    Person(bool b) : branching(b), in_branch(false),
+		     extra_pending(false), follow_pending(false) {}
+
+    virtual void init() {
+	Sim::self_signal_event(new Step(Treatment), 10.0);
+	death = Sim::self_signal_event(new Step(Death), 50.0);
+    }
+
+    // the branch: an extra event, and an earlier death
+    void treat() {
+	extra = Sim::self_signal_event(new Step(Extra), 1.0);
+	Sim::cancel_event(death);
+	Sim::self_signal_event(new Step(Death), 20.0);
+    }
+
+    virtual void process_event(const Event * e) {
+	int kind = static_cast<const Step *>(e)->kind;
+	if (in_branch) {
+	    // reuses the slot of the death event of the main run
+	    if (kind == Death)
+		follow = Sim::self_signal_event(new Step(Follow), 1.0);
+	    return;
+	}
+	history.push_back(std::make_pair(Sim::clock(), kind));
+	if (kind == Treatment) {
+	    if (branching) {
+		in_branch = true;
+		Sim::run_branch(boost::bind(&Person::treat, this));
+		in_branch = false;
+		CHECK(Sim::pending(death));
+		CHECK(!Sim::pending(extra));
+	    }
+	    // may reuse the slot of the extra event of the branch
+	    Sim::self_signal_event(new Step(Follow), 1.0);
+	    extra_pending = Sim::pending(extra);
+	    CHECK(!Sim::cancel_event(extra));
+	} else if (kind == Death) {
+	    // may reuse the slot of the follow-up event of the branch
+	    Sim::self_signal_event(new Step(Follow), 1.0);
+	    follow_pending = Sim::pending(follow);
+	    CHECK(!Sim::cancel_event(follow));
+	}
+    }
+};
+
+int main() {
+    Person reference(false);
+    Sim::create_process(&reference);
+    Sim::run_simulation();
+    Sim::clear();
+
+    Person p(true);
+    Sim::create_process(&p);
+    Sim::run_simulation();
+    Sim::clear();
+    CHECK(p.history == reference.history);
+    CHECK_EQ(p.history.size(), 4u);
+    CHECK(!p.extra_pending);
+    CHECK(!p.follow_pending);
+
+    return check_result("test-branch");
+}
@@ -0,0 +1,101 @@
+//
+// event cancellation through handles (Sim::cancel_event()): cancelled
+// events are never delivered and are released at once, stale handles
+// do not cancel the actions that reuse their slots, and tombstones
+// are compacted away once they are the majority of the schedule.
+//
+#include <vector>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+static int destroyed = 0;
+
+class Tick : public Event {
+public:
+    Tick(int i) : id(i) {}
+    ~Tick() { ++destroyed; }
+    int id;
+};
+
+class Canceller : public Process {
+public:
+    std::vector<EventHandle> handles;
+    std::vector<int> delivered;
+
+    virtual void init() {
+	for (int i = 0; i < 1000; ++i)
+	    handles.push_back(Sim::self_signal_event(new Tick(i), 1.0 + i));
+	// cancel all but every tenth event
+	for (int i = 0; i < 1000; ++i)
+	    if (i % 10 != 0) {
+		CHECK(Sim::pending(handles[i]));
+		CHECK(Sim::cancel_event(handles[i]));
+		CHECK(!Sim::pending(handles[i]));
+	    }
+	CHECK_EQ(destroyed, 900);
+	// a second cancellation is a no-op
+	CHECK(!Sim::cancel_event(handles[1]));
+    }
+
+    virtual void process_event(const Event * e) {
+	const Tick * t = static_cast<const Tick *>(e);
+	delivered.push_back(t->id);
+	// the handle of the current event is no longer pending
+	CHECK(!Sim::pending(handles[t->id]));
+    }
+};
+
+// a stale handle must not cancel a later action in the same slot
+class Recycler : public Process {
+public:
+    EventHandle first, second;
+    int n;
+
+    Recycler() : n(0) {}
+
+    virtual void init() {
+	first = Sim::self_signal_event(0, 1.0);
+    }
+
+    virtual void process_event(const Event *) {
+	if (++n == 1) {
+	    second = Sim::self_signal_event(0, 1.0);
+	    CHECK(!Sim::cancel_event(first));
+	    CHECK(Sim::pending(second));
+	}
+    }
+};
+
+int main() {
+    Canceller c;
+    Sim::create_process(&c);
+    Sim::reset_stats();
+    Sim::run_simulation();
+    CHECK_EQ(c.delivered.size(), 100u);
+    for (unsigned i = 0; i < c.delivered.size(); ++i)
+	CHECK_EQ(c.delivered[i], int(10*i));
+    CHECK_EQ(destroyed, 1000);
+    //
+    // tombstones are compacted once they are more than half of the
+    // schedule (and more than 64), so only a few are ever popped
+    //
+    const KernelStats & s = Sim::stats();
+    CHECK_EQ(s.cancelled, 900u);
+    CHECK(s.popped - s.executed <= 64);
+    Sim::clear();
+
+    Recycler r;
+    Sim::create_process(&r);
+    Sim::run_simulation();
+    CHECK_EQ(r.n, 2);
+    Sim::clear();
+
+    // handles do not survive clear()
+    CHECK(!Sim::pending(c.handles[0]));
+    CHECK(!Sim::cancel_event(r.second));
+
+    return check_result("test-cancel");
+}
@@ -0,0 +1,146 @@
+//
+// sequential processes written as coroutines (CoProcess, C++20):
+// delays, waiting for a kind of message with and without a timeout,
+// competing delays with first_of(), nested tasks, and the events that
+// the body does not await.
+//
+#include <stdexcept>
+#include <vector>
+
+#include <siena/ssim.h>
+#include <siena/coprocess.h>
+#include "check.h"
+
+using namespace ssim;
+
+class Message : public Event {
+public:
+    Message(int k) : kind(k) {}
+    int kind;
+};
+
+enum { toScreen = 1, toDiagnosis = 2 };
+
+//
+// the sender signals the person a screen at 1.0 and a diagnosis at
+// 3.0, then a diagnosis at 20.5, during the competing delays below
+//
+class Sender : public Process {
+public:
+    ProcessId person;
+
+    virtual void init() {
+	Sim::signal_event(person, new Message(toScreen), 1.0);
+	Sim::signal_event(person, new Message(toDiagnosis), 3.0);
+	Sim::signal_event(person, new Message(toDiagnosis), 20.5);
+    }
+
+    virtual void process_event(const Event *) {}
+};
+
+class Person : public CoProcess {
+public:
+    std::vector<Time> steps;
+    std::vector<int> kinds;
+    std::vector<int> risks;
+    int unawaited_kind;
+    int nested;
+    bool done;
+
+    Person() : unawaited_kind(0), nested(0), done(false) {}
+
+    virtual Task main() {
+	co_await delay(0.5);
+	steps.push_back(Sim::clock());				// 0.5
+
+	// the screen at 1.0 is not awaited
+	const Event * e = co_await wait_for_kind<Message>(toDiagnosis, 10.0);
+	steps.push_back(Sim::clock());				// 3.0
+	CHECK(e != 0);
+	if (e)
+	    kinds.push_back(static_cast<const Message *>(e)->kind);
+
+	// nothing comes: the timeout expires
+	e = co_await wait_for_kind<Message>(toDiagnosis, 1.0);
+	steps.push_back(Sim::clock());				// 4.0
+	CHECK(e == 0);
+
+	co_await follow_up();					// 6.0
+
+	// the shortest delay wins, and the lowest index on ties
+	FirstOf ties = first_of({ 3.0, 1.0, 1.0 });
+	risks.push_back(co_await ties);
+	steps.push_back(Sim::clock());				// 7.0
+
+	// only the shortest delay is scheduled
+	std::vector<Time> delays;
+	delays.push_back(8.0);
+	delays.push_back(16.0);
+	risks.push_back(co_await first_of(&delays[0], delays.size()));
+	steps.push_back(Sim::clock());				// 15.0
+
+	// an accepted event comes first
+	FirstOf message = first_of({ 10.0, 12.0 }, [](const Event * e) {
+		return dynamic_cast<const Message *>(e) != 0;
+	    });
+	risks.push_back(co_await message);
+	steps.push_back(Sim::clock());				// 20.5
+	CHECK(event() != 0);
+
+	// the cancelled delay (at 25.0) must not reach unawaited()
+	co_await delay(20.0);
+	steps.push_back(Sim::clock());				// 40.5
+	done = true;
+    }
+
+    Task follow_up() {
+	co_await delay(1.0);
+	++nested;
+	co_await delay(1.0);
+	++nested;
+    }
+
+    virtual void unawaited(const Event * e) {
+	const Message * m = dynamic_cast<const Message *>(e);
+	CHECK(m != 0);
+	if (m)
+	    unawaited_kind = m->kind;
+    }
+};
+
+int main() {
+    Person p;
+    Sender s;
+    s.person = Sim::create_process(&p);
+    Sim::create_process(&s);
+
+    // competing delays need at least one delay
+    bool rejected = false;
+    try {
+	p.first_of(0, 0);
+    } catch (const std::invalid_argument &) {
+	rejected = true;
+    }
+    CHECK(rejected);
+
+    Sim::run_simulation();
+    CHECK(p.done);
+    CHECK_EQ(p.unawaited_kind, int(toScreen));
+    CHECK_EQ(p.nested, 2);
+    CHECK_EQ(p.kinds.size(), 1u);
+    CHECK_EQ(p.risks.size(), 3u);
+    if (p.risks.size() == 3) {
+	CHECK_EQ(p.risks[0], 1);
+	CHECK_EQ(p.risks[1], 0);
+	CHECK_EQ(p.risks[2], -1);
+    }
+    const Time expected[] = { 0.5, 3.0, 4.0, 7.0, 15.0, 20.5, 40.5 };
+    CHECK_EQ(p.steps.size(), sizeof(expected)/sizeof(expected[0]));
+    for (unsigned i = 0; i < p.steps.size() && i < sizeof(expected)/sizeof(expected[0]); ++i)
+	CHECK_EQ(p.steps[i], expected[i]);
+    // the body returned, so the process is stopped and nothing is left
+    CHECK_EQ(Sim::clock(), 40.5);
+    Sim::clear();
+
+    return check_result("test-coprocess");
+}
@@ -0,0 +1,174 @@
+//
+// the event list containers of heap.h, tested directly against a
+// sorted reference: the radix heap with monotone keys, keys below the
+// last one popped (the overflow heap), large key ranges and
+// remove_if(), and the binary, d-ary and pairing heaps on the same
+// sequence of operations.  Peeking at the radix heap (as the kernel
+// does before each pop) must not move its last key.
+//
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+#include "heap.h"
+#include "check.h"
+
+using namespace ssim;
+
+struct Item {
+    unsigned long long key;
+    int id;
+
+    bool operator < (const Item & x) const {
+	return key < x.key || (key == x.key && id < x.id);
+    }
+};
+
+struct KeyOf {
+    unsigned long long operator()(const Item & x) const { return x.key; }
+};
+
+struct Odd {
+    bool operator()(const Item & x) const { return x.id % 2 != 0; }
+};
+
+static uint64_t state;
+
+static uint64_t draw() {
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 11;
+}
+
+//
+// a simulation-like workload: most keys are the last popped key plus
+// a delay, with small delays, ties, delays of every magnitude up to
+// the whole key range, and a few keys in the past
+//
+template <typename Heap>
+static int workload(Heap & h, bool monotone) {
+    std::set<Item> reference;
+    int errors = 0;
+    int id = 0;
+    unsigned long long now = 0;
+    state = 2718281828ULL;
+    for (int round = 0; round < 20000; ++round) {
+	int inserts = draw() % 3;
+	for (int i = 0; i < inserts; ++i) {
+	    Item x;
+	    unsigned long long d;
+	    switch (draw() % 5) {
+	    case 0: d = 0; break;
+	    case 1: d = draw() % 16; break;
+	    case 2: d = draw() % 100000; break;
+	    case 3: d = draw() << (draw() % 12); break;
+	    default: d = draw() >> (draw() % 53); break;
+	    }
+	    x.key = now + d;
+	    if (x.key < now)		// wrapped around
+		x.key = ~0ULL;
+	    if (!monotone && draw() % 50 == 0)
+		x.key = now - std::min(now, (unsigned long long)(draw() % 1000));
+	    x.id = id++;
+	    h.insert(x);
+	    reference.insert(x);
+	}
+	if (round % 5000 == 4999) {
+	    h.remove_if(Odd());
+	    for (std::set<Item>::iterator i = reference.begin(); i != reference.end(); )
+		if (Odd()(*i))
+		    reference.erase(i++);
+		else
+		    ++i;
+	}
+	if (h.size() != reference.size())
+	    return errors + 1;
+	if (!reference.empty() && draw() % 2) {
+	    Item x = h.pop_first();
+	    const Item & y = *reference.begin();
+	    if (x.key != y.key || x.id != y.id)
+		++errors;
+	    reference.erase(reference.begin());
+	    if (monotone)
+		now = x.key;
+	    else if (x.key > now)
+		now = x.key;
+	}
+    }
+    while (!reference.empty()) {
+	Item x = h.pop_first();
+	if (x.key != reference.begin()->key || x.id != reference.begin()->id)
+	    ++errors;
+	reference.erase(reference.begin());
+    }
+    if (!h.empty())
+	++errors;
+    return errors;
+}
+
+//
+// the pattern of a process with a pending event far ahead that, on
+// each tick, schedules one event now and the next tick a little
+// later, with a peek at the first element before every insert.
+// Ticks have even ids, the events scheduled now odd ones.
+//
+static void peek_then_insert() {
+    radix_heap<Item,KeyOf> h;
+    Item far = { 80000, 0 };
+    Item tick = { 0, 2 };
+    h.insert(far);
+    h.insert(tick);
+    int id = 4;
+    int ticks = 0;
+    unsigned long long now = 0;
+    for (;;) {
+	Item x = h.pop_first();
+	CHECK(x.key >= now);
+	now = x.key;
+	if (x.id == far.id)
+	    break;
+	if (x.id % 2 != 0 || now >= 50000)
+	    continue;
+	++ticks;
+	h.first();
+	Item a = { now, id + 1 };
+	h.insert(a);
+	h.first();
+	Item b = { now + 50, id };
+	h.insert(b);
+	id += 2;
+	if (h.overflow_size() != 0)
+	    break;
+    }
+    CHECK_EQ(ticks, 1000);
+    CHECK_EQ(h.overflow_size(), 0u);
+    CHECK(h.empty());
+}
+
+int main() {
+    peek_then_insert();
+    {
+	radix_heap<Item,KeyOf> h;
+	CHECK_EQ(workload(h, true), 0);
+	// the heap is reusable after it runs empty, and after clear()
+	CHECK_EQ(workload(h, false), 0);
+	Item x = { 5, 0 };
+	h.insert(x);
+	h.clear();
+	CHECK(h.empty());
+	CHECK_EQ(workload(h, true), 0);
+    }
+    {
+	heap<Item> h;
+	CHECK_EQ(workload(h, false), 0);
+    }
+    {
+	dary_heap<Item,4> h;
+	CHECK_EQ(workload(h, false), 0);
+    }
+    {
+	pairing_heap<Item> h;
+	CHECK_EQ(workload(h, false), 0);
+    }
+
+    return check_result("test-heap");
+}
@@ -0,0 +1,149 @@
+//
+// ordering of zero-delay actions (the FIFO lane of the schedule),
+// also when Sim::advance_delay() has moved the clock ahead of the
+// next action: events are delivered by time, and in scheduling order
+// at the same time.  An action scheduled in the past is counted as
+// out of order, and still delivered in order.
+//
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+class Signal : public Event {
+public:
+    Signal(Time t, int s) : due(t), seq(s) {}
+    Time due;
+    int seq;
+};
+
+static int next_seq = 0;
+static std::vector<Signal> received;
+
+static void send(ProcessId p, Time delay) {
+    Sim::signal_event(p, new Signal(Sim::clock() + delay, next_seq++), delay);
+}
+
+//
+// the advancer signals X at 1.0 to the receiver, advances the clock
+// to 2.0 and signals Y with no delay (at 2.0).  X takes the clock
+// back to 1.0, where the receiver signals Z to itself with no delay:
+// Z must come before Y.
+//
+class Receiver : public Process {
+public:
+    std::vector<char> names;
+
+    virtual void process_event(const Event * e) {
+	const Signal * s = static_cast<const Signal *>(e);
+	names.push_back(s->seq);
+	if (s->seq == 'X')
+	    Sim::self_signal_event(new Signal(1.0, 'Z'));
+    }
+};
+
+class Advancer : public Process {
+public:
+    ProcessId receiver;
+
+    virtual void init() {
+	Sim::signal_event(receiver, new Signal(1.0, 'X'), 1.0);
+	Sim::advance_delay(2.0);
+	Sim::signal_event(receiver, new Signal(2.0, 'Y'));
+    }
+
+    virtual void process_event(const Event *) {}
+};
+
+// at 1.0, signals the receiver P in the past (at 0.5) and Q at 2.0
+class Backdater : public Process {
+public:
+    ProcessId receiver;
+
+    virtual void init() {
+	Sim::self_signal_event(0, 1.0);
+    }
+
+    virtual void process_event(const Event *) {
+	Sim::signal_event(receiver, new Signal(2.0, 'Q'), 1.0);
+	Sim::signal_event(receiver, new Signal(0.5, 'P'), -0.5);
+    }
+};
+
+// a pseudo-random mix of delays, ties, zero delays and advance_delay().
+// Events for a process whose clock was advanced past them are dropped
+// as busy, so fewer events are received than sent.
+static uint64_t state = 12345;
+
+static unsigned draw(unsigned n) {
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return (state >> 33) % n;
+}
+
+static const int Processes = 20;
+static ProcessId pids[Processes];
+
+class Mixer : public Process {
+public:
+    virtual void init() {
+	send(Sim::this_process(), 0.5*draw(4));
+    }
+
+    virtual void process_event(const Event * e) {
+	received.push_back(*static_cast<const Signal *>(e));
+	if (next_seq > 20000)
+	    return;
+	if (draw(3) == 0)
+	    Sim::advance_delay(0.25*draw(8));
+	for (unsigned n = 1 + draw(2); n > 0; --n)
+	    send(pids[draw(Processes)], draw(2) ? 0.0 : 0.5*draw(4));
+    }
+};
+
+int main() {
+    Receiver r;
+    Advancer a;
+    a.receiver = Sim::create_process(&r);
+    Sim::create_process(&a);
+    Sim::run_simulation();
+    Sim::clear();
+    CHECK_EQ(r.names.size(), 3u);
+    if (r.names.size() == 3) {
+	CHECK_EQ(r.names[0], 'X');
+	CHECK_EQ(r.names[1], 'Z');
+	CHECK_EQ(r.names[2], 'Y');
+    }
+
+    Receiver late;
+    Backdater b;
+    b.receiver = Sim::create_process(&late);
+    Sim::create_process(&b);
+    Sim::reset_stats();
+    Sim::run_simulation();
+    Sim::clear();
+    CHECK_EQ(std::string(late.names.begin(), late.names.end()), std::string("PQ"));
+    CHECK_EQ(Sim::stats().out_of_order, 1u);
+
+    Sim::reset_stats();
+    std::vector<Mixer> mixers(Processes);
+    for (int i = 0; i < Processes; ++i)
+	pids[i] = Sim::create_process(&mixers[i]);
+    Sim::run_simulation();
+    Sim::clear();
+    CHECK(received.size() > 10000);	// some are dropped, as busy
+    int misordered = 0;
+    for (std::vector<Signal>::size_type i = 1; i < received.size(); ++i) {
+	const Signal & p = received[i - 1];
+	const Signal & s = received[i];
+	if (s.due < p.due || (s.due == p.due && s.seq < p.seq))
+	    ++misordered;
+    }
+    CHECK_EQ(misordered, 0);
+    CHECK_EQ(Sim::stats().out_of_order, 0u);
+
+    return check_result("test-lane");
+}
@@ -0,0 +1,124 @@
+//
+// observations (Sim::observe()) that schedule actions: the action
+// scheduled by a hook runs before the later observations, and before
+// the stop time, even when the next action in the schedule comes
+// after the stop time.  The observers of a process end with it, also
+// when run_concurrent() deletes the process and gives its id to the
+// next individual.
+//
+#include <string>
+#include <vector>
+#include <boost/bind/bind.hpp>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+class Visit : public Event {
+public:
+    Visit(char c) : name(c) {}
+    char name;
+};
+
+class Person : public Process {
+public:
+    std::string log;
+
+    virtual void init() {
+	std::vector<Time> ages;
+	ages.push_back(10.0);
+	ages.push_back(16.0);
+	Sim::observe(ages, boost::bind(&Person::observed, this, boost::placeholders::_1));
+	Sim::self_signal_event(new Visit('b'), 20.0);
+    }
+
+    // the first observation books a visit at 15
+    void observed(Time t) {
+	log += 'o';
+	if (t == 10.0)
+	    Sim::self_signal_event(new Visit('a'), 5.0);
+    }
+
+    virtual void process_event(const Event * e) {
+	log += static_cast<const Visit *>(e)->name;
+    }
+};
+
+//
+// individual 0 observes at 50 and leaves at 1, and is deleted by the
+// departure hook; individual 1 enters at 2, with the same pid, and
+// observes at 55
+//
+static std::vector<int> observed_by;
+static int departed = 0;
+
+static void observed(int i, Time t) {
+    observed_by.push_back(i);
+    CHECK_EQ(t, 55.0);
+}
+
+class Individual : public Process {
+public:
+    Individual(int i) : index(i) {}
+    int index;
+
+    virtual void init() {
+	std::vector<Time> ages(1, index == 0 ? 50.0 : 55.0);
+	Sim::observe(ages, boost::bind(observed, index, boost::placeholders::_1));
+	Sim::self_signal_event(0, index == 0 ? 1.0 : 60.0);
+    }
+
+    virtual void process_event(const Event *) {
+	Sim::stop_process();
+    }
+};
+
+static Individual * people[2];
+
+static Process * arrive(int i) {
+    return people[i] = new Individual(i);
+}
+
+static Time entry(int i) {
+    return 2.0*i;
+}
+
+static void depart(int i) {
+    delete people[i];
+    people[i] = 0;
+    ++departed;
+}
+
+int main() {
+    {
+	Person p;
+	Sim::create_process(&p);
+	Sim::set_stop_time(17.0);
+	Sim::run_simulation();
+	CHECK_EQ(p.log, std::string("oao"));
+	CHECK_EQ(Sim::clock(), 16.0);
+	Sim::clear();
+    }
+
+    {
+	Person p;
+	Sim::create_process(&p);
+	Sim::set_stop_time(INIT_TIME);
+	Sim::run_simulation();
+	CHECK_EQ(p.log, std::string("oaob"));
+	Sim::clear();
+    }
+
+    {
+	Sim::set_stop_time(INIT_TIME);
+	Sim::run_concurrent(arrive, 2, entry, depart);
+	CHECK_EQ(departed, 2);
+	CHECK_EQ(observed_by.size(), 1u);
+	if (observed_by.size() == 1)
+	    CHECK_EQ(observed_by[0], 1);
+	Sim::clear();
+    }
+
+    return check_result("test-observe");
+}
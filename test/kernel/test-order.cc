@@ -0,0 +1,110 @@
+//
+// order of simultaneous actions (packed schedule keys): events are
+// executed by time, then by priority (lower first), then in the order
+// in which they were scheduled, on every event list backend.
+//
+#include <vector>
+#include <stdint.h>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+class Item : public Event {
+public:
+    Item(Time t, int p, int s) : due(t), priority(p), seq(s) {}
+    Time due;
+    int priority;
+    int seq;
+};
+
+static std::vector<Item> delivered;
+
+static uint64_t state = 4711;
+
+static unsigned draw(unsigned n) {
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return (state >> 33) % n;
+}
+
+static const int Sinks = 5;
+static ProcessId sinks[Sinks];
+
+class Sink : public Process {
+public:
+    virtual void process_event(const Event * e) {
+	delivered.push_back(*static_cast<const Item *>(e));
+    }
+};
+
+// schedules a pseudo-random mix of times and priorities, with many ties
+class Source : public Process {
+public:
+    virtual void init() {
+	for (int i = 0; i < 5000; ++i) {
+	    Time d = 0.5*draw(20);
+	    int p = int(draw(5)) - 2;
+	    Sim::signal_event(sinks[draw(Sinks)], new Item(d, p, i), d,
+			      EventTag(-1, -1, p));
+	}
+    }
+
+    virtual void process_event(const Event *) {}
+};
+
+//
+// zero-delay events go behind the current one, and among themselves
+// by priority and then in scheduling order
+//
+class Now : public Process {
+public:
+    std::vector<int> order;
+
+    virtual void init() {
+	Sim::self_signal_event(new Item(1.0, 0, 0), 1.0);
+    }
+
+    virtual void process_event(const Event * e) {
+	const Item * i = static_cast<const Item *>(e);
+	order.push_back(i->seq);
+	if (i->seq == 0) {
+	    static const int priorities[] = { 2, -1, 0, -1, 2 };
+	    for (int k = 0; k < 5; ++k)
+		Sim::self_signal_event(new Item(1.0, priorities[k], k + 1), 0.0,
+				       EventTag(-1, -1, priorities[k]));
+	}
+    }
+};
+
+int main() {
+    std::vector<Sink> s(Sinks);
+    for (int i = 0; i < Sinks; ++i)
+	sinks[i] = Sim::create_process(&s[i]);
+    Source source;
+    Sim::create_process(&source);
+    Sim::run_simulation();
+    Sim::clear();
+    CHECK_EQ(delivered.size(), 5000u);
+    int misordered = 0;
+    for (std::vector<Item>::size_type i = 1; i < delivered.size(); ++i) {
+	const Item & p = delivered[i - 1];
+	const Item & q = delivered[i];
+	if (q.due < p.due
+	    || (q.due == p.due && (q.priority < p.priority
+				   || (q.priority == p.priority && q.seq < p.seq))))
+	    ++misordered;
+    }
+    CHECK_EQ(misordered, 0);
+
+    Now n;
+    Sim::create_process(&n);
+    Sim::run_simulation();
+    Sim::clear();
+    static const int expected[] = { 0, 2, 4, 3, 1, 5 };
+    CHECK_EQ(n.order.size(), 6u);
+    for (unsigned k = 0; k < n.order.size() && k < 6; ++k)
+	CHECK_EQ(n.order[k], expected[k]);
+
+    return check_result("test-order");
+}
@@ -0,0 +1,194 @@
+//
+// conservative parallel execution (ParallelSim): persons in every
+// partition visit a clinic in partition 0, and each process sees the
+// same history as in a sequential run, for 1, 2 and 4 partitions.
+// Also meant to be run with SANITIZE=thread.
+//
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+class Visit : public Event {
+public:
+    Visit(int s, ProcessId r = NULL_PROCESSID) : seq(s), reply(r) {}
+    int seq;
+    ProcessId reply;		// NULL_PROCESSID for a reply of the clinic
+
+    // events change hands between partitions
+    static void * operator new(std::size_t size) { return Sim::allocate(size); }
+    static void operator delete(void * p) { Sim::deallocate(p); }
+};
+
+typedef std::vector<std::pair<Time, int> > History;
+
+static ProcessId clinic_pid;
+
+class Clinic : public Process {
+public:
+    History history;
+
+    virtual void process_event(const Event * e) {
+	const Visit * v = static_cast<const Visit *>(e);
+	history.push_back(std::make_pair(Sim::clock(), v->seq));
+	Sim::signal_event(v->reply, new Visit(v->seq), 1.5);
+    }
+};
+
+class Person : public Process {
+public:
+    History history;
+
+    Person(int i) : state(i*2654435761u + 1), visits(0) {}
+
+    virtual void init() {
+	for (int j = 0; j < 5; ++j)
+	    Sim::self_signal_event(new Visit(j), 10*draw());
+    }
+
+    virtual void process_event(const Event * e) {
+	const Visit * v = static_cast<const Visit *>(e);
+	history.push_back(std::make_pair(Sim::clock(), v->seq));
+	if (v->reply != NULL_PROCESSID || v->seq >= 1000) {
+	    // a reply from the clinic, or a follow-up: book a visit
+	    Sim::signal_event(clinic_pid, new Visit(visits++, Sim::this_process()),
+			      1.0 + draw());
+	} else if (v->seq < 3) {
+	    Sim::self_signal_event(new Visit(1000 + v->seq), draw());
+	}
+    }
+
+private:
+    double draw() {
+	state = state*6364136223846793005ULL + 1442695040888963407ULL;
+	return double(state >> 11)/9007199254740992.0;
+    }
+
+    uint64_t state;
+    int visits;
+};
+
+static const int Persons = 500;
+static const Time Stop = 200.0;
+
+// runs on the sequential kernel when partitions is 0
+static void run(int partitions, Clinic & clinic, std::vector<Person> & persons,
+		unsigned long long * windows = 0) {
+    for (int i = 0; i < Persons; ++i)
+	persons.push_back(Person(i));
+    if (partitions == 0) {
+	clinic_pid = Sim::create_process(&clinic);
+	for (int i = 0; i < Persons; ++i)
+	    Sim::create_process(&persons[i]);
+	Sim::set_stop_time(Stop);
+	Sim::run_simulation();
+	Sim::clear();
+	return;
+    }
+    ParallelSim psim(partitions, 1.0);
+    clinic_pid = psim.create_process(0, &clinic);
+    for (int i = 0; i < Persons; ++i)
+	psim.create_process(i % partitions, &persons[i]);
+    psim.set_stop_time(Stop);
+    psim.run();
+    if (windows)
+	*windows = psim.windows();
+}
+
+// a process that signals another partition with too short a delay
+class Hasty : public Process {
+public:
+    ProcessId peer;
+
+    virtual void init() {
+	Sim::signal_event(peer, 0, 0.5);
+    }
+
+    virtual void process_event(const Event *) {}
+};
+
+// a process that runs its own ParallelSim, from one of its partitions
+class Nested : public Process {
+public:
+    ParallelSim * psim;
+    bool rejected;
+
+    Nested(ParallelSim * p) : psim(p), rejected(false) {}
+
+    virtual void init() {
+	try {
+	    psim->run();
+	} catch (std::logic_error &) {
+	    rejected = true;
+	}
+    }
+
+    virtual void process_event(const Event *) {}
+};
+
+int main() {
+    Clinic sequential;
+    std::vector<Person> reference;
+    reference.reserve(Persons);
+    run(0, sequential, reference);
+    CHECK(sequential.history.size() > 1000u);
+
+    for (int p = 1; p <= 4; p *= 2) {
+	Clinic clinic;
+	std::vector<Person> persons;
+	persons.reserve(Persons);
+	unsigned long long windows = 0;
+	run(p, clinic, persons, &windows);
+	CHECK(windows > 0);
+	CHECK(clinic.history == sequential.history);
+	int differ = 0;
+	for (int i = 0; i < Persons; ++i)
+	    if (persons[i].history != reference[i].history)
+		++differ;
+	CHECK_EQ(differ, 0);
+    }
+
+    {
+	Hasty a, b;
+	ParallelSim psim(2, 1.0);
+	a.peer = b.peer = psim.create_process(1, &b);
+	psim.create_process(0, &a);
+	bool thrown = false;
+	try {
+	    psim.run();
+	} catch (std::logic_error &) {
+	    thrown = true;
+	}
+	CHECK(thrown);
+    }
+
+    {
+	//
+	// ParallelSim::run() is rejected while one of the partitions is
+	// running, and the simulation can still be run afterwards
+	//
+	ParallelSim psim(2, 1.0);
+	Nested nested(&psim);
+	{
+	    SimContext::Scope scope(psim.context(1));
+	    Sim::create_process(&nested);
+	    Sim::run_simulation();
+	}
+	CHECK(nested.rejected);
+	Clinic clinic;
+	clinic_pid = psim.create_process(0, &clinic);
+	Person person(0);
+	psim.create_process(1, &person);
+	psim.set_stop_time(Stop);
+	psim.run();
+	CHECK(!clinic.history.empty());
+	CHECK(person.history.size() > 8);	// with replies of the clinic
+    }
+
+    return check_result("test-parallel");
+}
@@ -0,0 +1,150 @@
+//
+// runs in windows (Sim::run_until()): the clock is set to the end of
+// each window, but not beyond the stop time, and run_until() tells
+// whether the simulation can carry on, ignoring cancelled actions and
+// counting the observations that remain.
+//
+#include <vector>
+#include <boost/bind/bind.hpp>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+// an event at each half year, and one cancelled at 100
+class Ticker : public Process {
+public:
+    std::vector<Time> seen;
+    int n;
+    bool stop_early;
+
+    Ticker(int count, bool stop = false) : n(count), stop_early(stop) {}
+
+    virtual void init() {
+	for (int i = 0; i < n; ++i)
+	    Sim::self_signal_event(0, 0.5 + i);
+	Sim::cancel_event(Sim::self_signal_event(0, 100.0));
+    }
+
+    virtual void process_event(const Event *) {
+	seen.push_back(Sim::clock());
+	if (stop_early && seen.size() == 2)
+	    Sim::stop_simulation();
+    }
+};
+
+// observed at 2.5 and 3.5, with no action of its own
+class Watcher : public Process {
+public:
+    std::vector<Time> seen;
+
+    virtual void init() {
+	std::vector<Time> ages;
+	ages.push_back(2.5);
+	ages.push_back(3.5);
+	Sim::observe(ages, boost::bind(&Watcher::observed, this, boost::placeholders::_1));
+    }
+
+    void observed(Time t) { seen.push_back(t); }
+
+    virtual void process_event(const Event *) {}
+};
+
+// an event at 2.5, and one at 2.1 that is cancelled
+class Late : public Process {
+public:
+    int n;
+
+    Late() : n(0) {}
+
+    virtual void init() {
+	Sim::self_signal_event(0, 2.5);
+	Sim::cancel_event(Sim::self_signal_event(0, 2.1));
+    }
+
+    virtual void process_event(const Event *) { ++n; }
+};
+
+int main() {
+    {
+	// the last window is the one for which run_until() is false
+	Ticker ticker(3);
+	Sim::create_process(&ticker);
+	std::vector<Time> clocks;
+	std::vector<unsigned> seen;
+	for (Time t = 1.0; Sim::run_until(t); t += 1.0) {
+	    clocks.push_back(Sim::clock());
+	    seen.push_back(ticker.seen.size());
+	}
+	clocks.push_back(Sim::clock());
+	seen.push_back(ticker.seen.size());
+	CHECK_EQ(clocks.size(), 3u);
+	for (unsigned i = 0; i < clocks.size() && i < 3; ++i) {
+	    CHECK_EQ(clocks[i], 1.0 + i);
+	    CHECK_EQ(seen[i], i + 1);
+	}
+	Sim::clear();
+    }
+
+    {
+	// the clock stops at the stop time, and the later actions stay
+	Ticker ticker(10);
+	Sim::create_process(&ticker);
+	Sim::set_stop_time(2.2);
+	CHECK(Sim::run_until(1.0));
+	CHECK(!Sim::run_until(2.0));	// the next action is at 2.5
+	CHECK_EQ(Sim::clock(), 2.0);
+	CHECK(!Sim::run_until(3.0));
+	CHECK_EQ(Sim::clock(), 2.2);
+	CHECK_EQ(ticker.seen.size(), 2u);
+	Sim::set_stop_time(INIT_TIME);
+	Sim::resume();
+	CHECK_EQ(ticker.seen.size(), 10u);
+	Sim::clear();
+    }
+
+    {
+	// stop_simulation() ends the windows, resume() carries on
+	Ticker ticker(5, true);
+	Sim::create_process(&ticker);
+	int windows = 0;
+	for (Time t = 1.0; Sim::run_until(t); t += 1.0)
+	    ++windows;
+	CHECK_EQ(windows, 1);
+	CHECK_EQ(Sim::clock(), 1.5);
+	Sim::resume();
+	CHECK_EQ(ticker.seen.size(), 5u);
+	Sim::clear();
+    }
+
+    {
+	// only observations remain after the window: they carry on
+	Watcher watcher;
+	Sim::create_process(&watcher);
+	CHECK(Sim::run_until(1.0));
+	CHECK(Sim::run_until(3.0));
+	CHECK_EQ(watcher.seen.size(), 1u);
+	CHECK(!Sim::run_until(4.0));
+	CHECK_EQ(watcher.seen.size(), 2u);
+	Sim::clear();
+    }
+
+    {
+	// a cancelled action before the stop time does not stand in for
+	// the next live one, which comes after it
+	Late late;
+	Sim::create_process(&late);
+	Sim::set_stop_time(2.2);
+	CHECK(!Sim::run_until(2.0));
+	CHECK(!Sim::run_until(3.0));
+	CHECK_EQ(Sim::clock(), 2.2);
+	CHECK_EQ(late.n, 0);
+	Sim::set_stop_time(INIT_TIME);
+	Sim::resume();
+	CHECK_EQ(late.n, 1);
+	Sim::clear();
+    }
+
+    return check_result("test-run-until");
+}
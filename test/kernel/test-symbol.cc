@@ -0,0 +1,76 @@
+//
+// the symbol table (Sim::symbol(), Sim::symbol_name()) shared by the
+// threads: the same name maps to the same symbol in every thread,
+// while other threads intern new names and read names without the
+// lock, and the names read back are the ones interned.
+//
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+static const int Threads = 4;
+static const int Names = 4999;	// a prime, so every stride visits every name
+
+static std::string name_of(int i) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "name-%d", i);
+    return buf;
+}
+
+static std::vector<int> ids[Threads];
+static int mismatched[Threads];
+
+// each thread interns all the names, in its own order, and reads back
+// the names of symbols that others may be publishing at the same time
+static void intern(int t) {
+    ids[t].assign(Names, -1);
+    for (int k = 0; k < Names; ++k) {
+	int i = (k*(2*t + 1) + t*997) % Names;
+	int id = Sim::symbol(name_of(i));
+	ids[t][i] = id;
+	if (Sim::symbol_name(id) != name_of(i))
+	    ++mismatched[t];
+	if (Sim::symbol(name_of(i)) != id)	// from the cache of the thread
+	    ++mismatched[t];
+    }
+}
+
+int main() {
+    CHECK_EQ(Sim::symbol(""), -1);
+    CHECK(Sim::symbol_name(-1).empty());
+    CHECK(Sim::symbol_name(1 << 30).empty());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t)
+	threads.push_back(std::thread(intern, t));
+    for (int t = 0; t < Threads; ++t)
+	threads[t].join();
+
+    std::vector<bool> used(Names, false);
+    for (int t = 0; t < Threads; ++t) {
+	CHECK_EQ(mismatched[t], 0);
+	for (int i = 0; i < Names; ++i)
+	    CHECK_EQ(ids[t][i], ids[0][i]);
+    }
+    // the symbols are the first Names integers
+    for (int i = 0; i < Names; ++i)
+	if (ids[0][i] >= 0 && ids[0][i] < Names)
+	    used[ids[0][i]] = true;
+    int unused = 0;
+    for (int i = 0; i < Names; ++i)
+	if (!used[i])
+	    ++unused;
+    CHECK_EQ(unused, 0);
+
+    // the main thread did not intern these: they are found in the table
+    CHECK_EQ(Sim::symbol(name_of(42)), ids[1][42]);
+    CHECK(Sim::symbol_name(ids[2][7]) == name_of(7));
+
+    return check_result("test-symbol");
+}
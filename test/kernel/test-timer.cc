@@ -0,0 +1,121 @@
+//
+// recurring timers (Sim::self_signal_timer()): a timer fires every
+// period up to its stop time with a single schedule entry, stays
+// pending until its last firing, and goes away with cancel_event(),
+// remove_kind(), stop_process() or clear(), releasing its event.
+//
+#include <vector>
+
+#include <siena/ssim.h>
+#include "check.h"
+
+using namespace ssim;
+
+static int destroyed = 0;
+
+class Tick : public Event {
+public:
+    Tick(int i) : id(i) {}
+    ~Tick() { ++destroyed; }
+    int id;
+};
+
+class Screening : public Process {
+public:
+    std::vector<Time> rounds;
+    EventHandle timer;
+    Time cancel_at;
+    bool pending_in_rounds;
+
+    Screening(Time c = INIT_TIME) : cancel_at(c), pending_in_rounds(true) {}
+
+    virtual void init() {
+	// every 10 years from 10 to 100
+	timer = Sim::self_signal_timer(new Tick(1), 10.0, 10.0, 100.0, EventTag(3));
+	Sim::self_signal_event(new Tick(2), 200.0);
+    }
+
+    virtual void process_event(const Event * e) {
+	if (static_cast<const Tick *>(e)->id != 1)
+	    return;
+	rounds.push_back(Sim::clock());
+	// the timer is re-armed before the event is delivered
+	if (Sim::clock() < 100.0 && !Sim::pending(timer))
+	    pending_in_rounds = false;
+	if (Sim::clock() == cancel_at)
+	    CHECK(Sim::cancel_event(timer));
+    }
+};
+
+class Stopper : public Process {
+public:
+    int n;
+    bool by_kind;
+
+    Stopper(bool k) : n(0), by_kind(k) {}
+
+    virtual void init() {
+	Sim::self_signal_timer(new Tick(1), 1.0, 1.0, 1e9, EventTag(0));
+    }
+
+    virtual void process_event(const Event *) {
+	if (++n == 5) {
+	    if (by_kind)
+		Sim::remove_kind(Sim::this_process(), 0);
+	    else
+		Sim::stop_process();
+	}
+    }
+};
+
+int main() {
+    {
+	Screening s;
+	Sim::create_process(&s);
+	Sim::reset_stats();
+	Sim::run_simulation();
+	CHECK_EQ(s.rounds.size(), 10u);
+	for (unsigned i = 0; i < s.rounds.size(); ++i)
+	    CHECK_EQ(s.rounds[i], 10.0*(i + 1));
+	CHECK(s.pending_in_rounds);
+	CHECK(!Sim::pending(s.timer));
+	// one schedule entry for the timer, and one for the other event
+	CHECK_EQ(Sim::stats().max_queue, 2u);
+	CHECK_EQ(destroyed, 2);
+	Sim::clear();
+    }
+
+    {
+	destroyed = 0;
+	Screening s(40.0);
+	Sim::create_process(&s);
+	Sim::run_simulation();
+	CHECK_EQ(s.rounds.size(), 4u);
+	CHECK_EQ(destroyed, 2);
+	Sim::clear();
+    }
+
+    for (int by_kind = 0; by_kind < 2; ++by_kind) {
+	destroyed = 0;
+	Stopper s(by_kind);
+	Sim::create_process(&s);
+	Sim::run_simulation();
+	CHECK_EQ(s.n, 5);
+	CHECK_EQ(destroyed, 1);
+	Sim::clear();
+    }
+
+    {
+	destroyed = 0;
+	Screening s;
+	Sim::create_process(&s);
+	Sim::run_until(55.0);
+	CHECK_EQ(s.rounds.size(), 5u);
+	CHECK(Sim::pending(s.timer));
+	Sim::clear();
+	CHECK_EQ(destroyed, 2);
+	CHECK(!Sim::pending(s.timer));
+    }
+
+    return check_result("test-timer");
+}
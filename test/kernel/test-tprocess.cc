@@ -0,0 +1,179 @@
+//
+// sequential processes (TProcess) and their pooled stacks: stacks go
+// back to the pool when a process stops and are reused, the high
+// water mark of stack usage is right for reused stacks, pooled
+// stacks are unmapped by release_stacks(), and a guard page turns a
+// stack overflow into a fault.
+//
+// With an argument, it also runs that many concurrent processes and
+// reports the time and the memory they take, e.g.
+//
+//   ./test-tprocess 100000
+//
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <siena/tprocess.h>
+#include "check.h"
+
+using namespace ssim;
+
+static uint64_t state = 31415;
+
+static double draw() {
+    state = state*6364136223846793005ULL + 1442695040888963407ULL;
+    return double(state >> 11)/9007199254740992.0;
+}
+
+// waits for a few timeouts, then stops
+class Patient : public TProcess {
+public:
+    int visits;
+    int seen;
+
+    Patient(int n, unsigned long stack = DefaultStackSize)
+	: TProcess(stack), visits(n), seen(0) {}
+
+    virtual void main() {
+	for (int i = 0; i < visits; ++i) {
+	    wait_for_event(1.0 + draw());
+	    ++seen;
+	}
+    }
+};
+
+// writes about depth kilobytes of its stack
+static int deep(int depth) {
+    volatile char buffer[1024];
+    for (unsigned i = 0; i < sizeof(buffer); ++i)
+	buffer[i] = char(i + depth);
+    return depth > 1 ? deep(depth - 1) + buffer[depth] : buffer[0];
+}
+
+class Deep : public TProcess {
+public:
+    int depth;
+
+    Deep(int d, unsigned long stack) : TProcess(stack), depth(d) {}
+
+    virtual void main() {
+	deep(depth);
+	wait_for_event(1.0);
+    }
+};
+
+static double seconds() {
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void scale(int n) {
+    TProcess::StackGuard = false;	// see TProcess::StackGuard
+    TProcess::reset_stack_high_water();
+    std::vector<Patient *> patients;
+    for (int i = 0; i < n; ++i) {
+	patients.push_back(new Patient(5));
+	Sim::create_process(patients.back());
+    }
+    double start = seconds();
+    Sim::run_simulation();
+    double elapsed = seconds() - start;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("%d processes, %d events: %.3f s, %.0f ns/event, "
+		"%lu stacks mapped, high water %lu bytes, max RSS %ld KB\n",
+		n, 5*n, elapsed, 1e9*elapsed/(5.0*n), TProcess::stacks_mapped(),
+		TProcess::stack_high_water(), long(usage.ru_maxrss));
+    int seen = 0;
+    for (int i = 0; i < n; ++i) {
+	seen += patients[i]->seen;
+	delete patients[i];
+    }
+    CHECK_EQ(seen, 5*n);
+    Sim::clear();
+    TProcess::release_stacks();
+    TProcess::StackGuard = true;
+}
+
+int main(int argc, char * argv[]) {
+    const unsigned long page = sysconf(_SC_PAGESIZE);
+    {
+	// 100 concurrent processes take 7 chunks of 16 stacks
+	std::vector<Patient> patients(100, Patient(3));
+	for (unsigned i = 0; i < patients.size(); ++i)
+	    Sim::create_process(&patients[i]);
+	Sim::run_simulation();
+	Sim::clear();
+	CHECK_EQ(TProcess::stacks_in_use(), 0u);
+	CHECK_EQ(TProcess::stacks_mapped(), 112u);
+	int seen = 0;
+	for (unsigned i = 0; i < patients.size(); ++i)
+	    seen += patients[i].seen;
+	CHECK_EQ(seen, 300);
+    }
+    {
+	// the stacks are reused
+	std::vector<Patient> patients(100, Patient(3));
+	for (unsigned i = 0; i < patients.size(); ++i)
+	    Sim::create_process(&patients[i]);
+	Sim::run_simulation();
+	Sim::clear();
+	CHECK_EQ(TProcess::stacks_mapped(), 112u);
+    }
+    {
+	// a deep stack, and then a shallow one in the same stack
+	const unsigned long size = 16*page;
+	Deep d(8, size);
+	Sim::create_process(&d);
+	Sim::run_simulation();
+	Sim::clear();
+	unsigned long deep_usage = TProcess::stack_high_water();
+	CHECK(deep_usage > 8*1024);
+	CHECK(deep_usage < size);
+	TProcess::reset_stack_high_water();
+	Deep s(1, size);
+	Sim::create_process(&s);
+	Sim::run_simulation();
+	Sim::clear();
+	CHECK(TProcess::stack_high_water() > 0);
+	CHECK(TProcess::stack_high_water() < deep_usage - 4*1024);
+    }
+    TProcess::release_stacks();
+    CHECK_EQ(TProcess::stacks_mapped(), 0u);
+
+    {
+	//
+	// an overflow of a guarded stack faults (in a child process).
+	// Under a sanitizer, the fault is reported and the child exits.
+	//
+	std::fflush(stdout);
+	pid_t child = fork();
+	if (child == 0) {
+	    int null = open("/dev/null", O_WRONLY);
+	    dup2(null, 2);
+	    Deep d(64, 4*page);
+	    Sim::create_process(&d);
+	    Sim::run_simulation();
+	    _exit(0);
+	}
+	int status = 0;
+	waitpid(child, &status, 0);
+	if (WIFSIGNALED(status))
+	    CHECK(WTERMSIG(status) == SIGSEGV || WTERMSIG(status) == SIGBUS);
+	else
+	    CHECK(WIFEXITED(status) && WEXITSTATUS(status) != 0);
+    }
+
+    if (argc > 1)
+	scale(std::atoi(argv[1]));
+
+    return check_result("test-tprocess");
+}